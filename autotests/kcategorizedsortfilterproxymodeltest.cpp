@@ -0,0 +1,567 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <QSignalSpy>
+#include <QStandardItemModel>
+
+#include <kcategorizedsortfilterproxymodel.h>
+
+#include <memory>
+
+class CountingModel : public QStandardItemModel
+{
+public:
+    using QStandardItemModel::QStandardItemModel;
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (role == KCategorizedSortFilterProxyModel::CategorySortRole) {
+            ++categorySortRoleCalls;
+        }
+        return QStandardItemModel::data(index, role);
+    }
+
+    mutable int categorySortRoleCalls = 0;
+};
+
+class ReversedSubSortProxyModel : public KCategorizedSortFilterProxyModel
+{
+public:
+    using KCategorizedSortFilterProxyModel::KCategorizedSortFilterProxyModel;
+
+protected:
+    bool subSortLessThan(const QModelIndex &left, const QModelIndex &right) const override
+    {
+        return left.data(sortRole()).toInt() > right.data(sortRole()).toInt();
+    }
+};
+
+class MapCountingProxyModel : public KCategorizedSortFilterProxyModel
+{
+public:
+    using KCategorizedSortFilterProxyModel::KCategorizedSortFilterProxyModel;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override
+    {
+        ++mapToSourceCalls;
+        return KCategorizedSortFilterProxyModel::mapToSource(proxyIndex);
+    }
+
+    mutable int mapToSourceCalls = 0;
+};
+
+static const int KindRole = Qt::UserRole + 1;
+
+// the kind of a row is its category, like an enum
+class KeyedProxyModel : public KCategorizedSortFilterProxyModel
+{
+public:
+    using KCategorizedSortFilterProxyModel::KCategorizedSortFilterProxyModel;
+
+    mutable int categoryDisplayCalls = 0;
+
+protected:
+    quint64 categoryKey(int sourceRow) const override
+    {
+        return sourceModel()->index(sourceRow, 0).data(KindRole).toULongLong();
+    }
+
+    QString categoryDisplay(quint64 key) const override
+    {
+        ++categoryDisplayCalls;
+        return QStringLiteral("Kind %1").arg(key);
+    }
+};
+
+class KCategorizedSortFilterProxyModelTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testSortKeysAskedOnce();
+    void testSortKeysFollowSourceChanges();
+    void testStringSortKeys_data();
+    void testStringSortKeys();
+    void testChangedStringSortKeys();
+    void testParallelSort_data();
+    void testParallelSort();
+    void testCategoryTable();
+    void testCategoryKeys_data();
+    void testCategoryKeys();
+    void testCategoryFilter();
+    void testCategoryFilterBeforeSorting();
+    void testCategoryAggregates();
+    void testCategoryAggregatesAcrossInsertions();
+
+private:
+    static QStandardItem *createItem(const QVariant &categorySortKey, const QString &text = QString());
+    QVariantList proxySortKeys() const;
+    void verifySorted();
+
+    CountingModel *m_model = nullptr;
+    KCategorizedSortFilterProxyModel *m_proxyModel = nullptr;
+};
+
+void KCategorizedSortFilterProxyModelTest::init()
+{
+    m_model = new CountingModel(this);
+    m_proxyModel = new KCategorizedSortFilterProxyModel(this);
+    m_proxyModel->setCategorizedModel(true);
+    m_proxyModel->setSourceModel(m_model);
+}
+
+void KCategorizedSortFilterProxyModelTest::cleanup()
+{
+    delete m_proxyModel;
+    delete m_model;
+}
+
+QStandardItem *KCategorizedSortFilterProxyModelTest::createItem(const QVariant &categorySortKey, const QString &text)
+{
+    auto *item = new QStandardItem(text.isEmpty() ? categorySortKey.toString() : text);
+    item->setData(categorySortKey.toString(), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+    item->setData(categorySortKey, KCategorizedSortFilterProxyModel::CategorySortRole);
+    return item;
+}
+
+QVariantList KCategorizedSortFilterProxyModelTest::proxySortKeys() const
+{
+    QVariantList keys;
+    for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+        keys << m_proxyModel->index(row, 0).data(KCategorizedSortFilterProxyModel::CategorySortRole);
+    }
+    return keys;
+}
+
+void KCategorizedSortFilterProxyModelTest::verifySorted()
+{
+    const QVariantList keys = proxySortKeys();
+    for (int row = 1; row < keys.count(); ++row) {
+        QVERIFY2(keys.at(row - 1).toLongLong() <= keys.at(row).toLongLong(), qPrintable(QStringLiteral("row %1").arg(row)));
+    }
+}
+
+void KCategorizedSortFilterProxyModelTest::testSortKeysAskedOnce()
+{
+    for (int i = 0; i < 1000; ++i) {
+        m_model->appendRow(createItem(qlonglong((i * 7919) % 50)));
+    }
+    m_model->categorySortRoleCalls = 0;
+
+    m_proxyModel->sort(0);
+    verifySorted();
+    // once per row, not once per comparison
+    QVERIFY(m_model->categorySortRoleCalls <= m_model->rowCount());
+}
+
+void KCategorizedSortFilterProxyModelTest::testSortKeysFollowSourceChanges()
+{
+    for (int i = 0; i < 20; ++i) {
+        m_model->appendRow(createItem(qlonglong(i % 5)));
+    }
+    m_proxyModel->sort(0);
+    verifySorted();
+
+    m_model->item(0)->setData(qlonglong(10), KCategorizedSortFilterProxyModel::CategorySortRole);
+    verifySorted();
+    QCOMPARE(proxySortKeys().constLast().toLongLong(), 10);
+
+    m_model->insertRow(3, createItem(qlonglong(-1)));
+    verifySorted();
+    QCOMPARE(proxySortKeys().constFirst().toLongLong(), -1);
+
+    m_model->removeRows(0, 5);
+    verifySorted();
+    QCOMPARE(m_proxyModel->rowCount(), 16);
+    QVERIFY(proxySortKeys().constLast().toLongLong() < 10);
+
+    m_model->item(2)->setData(qlonglong(-5), KCategorizedSortFilterProxyModel::CategorySortRole);
+    verifySorted();
+    QCOMPARE(proxySortKeys().constFirst().toLongLong(), -5);
+}
+
+void KCategorizedSortFilterProxyModelTest::testStringSortKeys_data()
+{
+    QTest::addColumn<bool>("naturalComparison");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("natural") << true << QStringList{QStringLiteral("Category 2"), QStringLiteral("Category 9"), QStringLiteral("Category 10")};
+    QTest::newRow("plain") << false << QStringList{QStringLiteral("Category 10"), QStringLiteral("Category 2"), QStringLiteral("Category 9")};
+}
+
+void KCategorizedSortFilterProxyModelTest::testStringSortKeys()
+{
+    QFETCH(bool, naturalComparison);
+    QFETCH(QStringList, expected);
+
+    m_proxyModel->setSortCategoriesByNaturalComparison(naturalComparison);
+    for (const QString &category : {QStringLiteral("Category 9"), QStringLiteral("Category 10"), QStringLiteral("Category 2")}) {
+        m_model->appendRow(createItem(category));
+    }
+    m_proxyModel->sort(0);
+
+    QStringList categories;
+    for (const QVariant &key : proxySortKeys()) {
+        categories << key.toString();
+    }
+    QCOMPARE(categories, expected);
+}
+
+void KCategorizedSortFilterProxyModelTest::testChangedStringSortKeys()
+{
+    for (const QString &category : {QStringLiteral("Category 2"), QStringLiteral("Category 10"), QStringLiteral("Category 30"), QStringLiteral("Category 20")}) {
+        m_model->appendRow(createItem(category));
+    }
+    m_proxyModel->sort(0);
+    const auto categories = [this]() {
+        QStringList categories;
+        for (const QVariant &key : proxySortKeys()) {
+            categories << key.toString();
+        }
+        return categories;
+    };
+
+    // keys which were not ranked yet are sorted among the ranked ones
+    m_model->item(0)->setData(QStringLiteral("Category 25"), KCategorizedSortFilterProxyModel::CategorySortRole);
+    QCOMPARE(categories(), (QStringList{QStringLiteral("Category 10"), QStringLiteral("Category 20"), QStringLiteral("Category 25"), QStringLiteral("Category 30")}));
+    m_model->appendRow(createItem(QStringLiteral("Category 9")));
+    m_model->item(3)->setData(QStringLiteral("Category 10"), KCategorizedSortFilterProxyModel::CategorySortRole);
+    QCOMPARE(categories(),
+             (QStringList{QStringLiteral("Category 9"), QStringLiteral("Category 10"), QStringLiteral("Category 10"), QStringLiteral("Category 25"), QStringLiteral("Category 30")}));
+
+    // and ranked on the next full sort
+    m_proxyModel->sort(0, Qt::DescendingOrder);
+    m_proxyModel->sort(0);
+    QCOMPARE(categories(),
+             (QStringList{QStringLiteral("Category 9"), QStringLiteral("Category 10"), QStringLiteral("Category 10"), QStringLiteral("Category 25"), QStringLiteral("Category 30")}));
+}
+
+void KCategorizedSortFilterProxyModelTest::testParallelSort_data()
+{
+    QTest::addColumn<bool>("categorized");
+    QTest::addColumn<bool>("stringCategories");
+    QTest::addColumn<bool>("stringSubSortKeys");
+    QTest::addColumn<bool>("subSortKeyExtractor");
+    QTest::addColumn<Qt::SortOrder>("order");
+
+    QTest::newRow("number keys") << true << false << false << false << Qt::AscendingOrder;
+    QTest::newRow("number keys, descending") << true << false << false << false << Qt::DescendingOrder;
+    QTest::newRow("string keys") << true << true << true << false << Qt::AscendingOrder;
+    QTest::newRow("not categorized") << false << false << true << false << Qt::AscendingOrder;
+    QTest::newRow("sub-sort key extractor") << true << true << false << true << Qt::AscendingOrder;
+}
+
+void KCategorizedSortFilterProxyModelTest::testParallelSort()
+{
+    QFETCH(bool, categorized);
+    QFETCH(bool, stringCategories);
+    QFETCH(bool, stringSubSortKeys);
+    QFETCH(bool, subSortKeyExtractor);
+    QFETCH(Qt::SortOrder, order);
+
+    // enough rows to be sorted in several chunks, with many equal keys
+    for (int i = 0; i < 40000; ++i) {
+        const int category = (i * 7919) % 37;
+        auto *item = new QStandardItem;
+        item->setData(QStringLiteral("Category %1").arg(category), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+        item->setData(stringCategories ? QVariant(QStringLiteral("Category %1").arg(category)) : QVariant(qlonglong(category)),
+                      KCategorizedSortFilterProxyModel::CategorySortRole);
+        const int subSortKey = int(qint64(i) * 104729 % 5003);
+        item->setData(stringSubSortKeys ? QVariant(QStringLiteral("Item %1").arg(subSortKey)) : QVariant(subSortKey), Qt::DisplayRole);
+        m_model->appendRow(item);
+    }
+
+    std::unique_ptr<KCategorizedSortFilterProxyModel> reference(subSortKeyExtractor ? new ReversedSubSortProxyModel : new KCategorizedSortFilterProxyModel);
+    reference->setCategorizedModel(categorized);
+    reference->setSourceModel(m_model);
+    reference->sort(0, order);
+
+    m_proxyModel->setCategorizedModel(categorized);
+    m_proxyModel->setSortMode(KCategorizedSortFilterProxyModel::ParallelSort);
+    if (subSortKeyExtractor) {
+        m_proxyModel->setSubSortKeyExtractor([](const QModelIndex &index) {
+            return QVariant(-index.data(Qt::DisplayRole).toInt());
+        });
+    }
+    QSignalSpy layoutChangedSpy(m_proxyModel, &QAbstractItemModel::layoutChanged);
+    m_proxyModel->sort(0, order);
+    QCOMPARE(layoutChangedSpy.count(), 1);
+
+    QCOMPARE(m_proxyModel->rowCount(), reference->rowCount());
+    for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+        QCOMPARE(m_proxyModel->mapToSource(m_proxyModel->index(row, 0)).row(), reference->mapToSource(reference->index(row, 0)).row());
+    }
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryTable()
+{
+    for (int i = 0; i < 12; ++i) {
+        m_model->appendRow(createItem(qlonglong(i / 4)));
+    }
+    m_proxyModel->sort(0);
+
+    QCOMPARE(m_proxyModel->categoryCount(), 3);
+    const KCategorizedSortFilterProxyModel::Category second = m_proxyModel->categoryAt(1);
+    QCOMPARE(second.display, QStringLiteral("1"));
+    QCOMPARE(second.sortKey.toLongLong(), 1);
+    QCOMPARE(second.firstRow, 4);
+    QCOMPARE(second.count, 4);
+    QCOMPARE(m_proxyModel->categoryAt(3).firstRow, -1);
+    QCOMPARE(m_proxyModel->categoryForRow(0), 0);
+    QCOMPARE(m_proxyModel->categoryForRow(7), 1);
+    QCOMPARE(m_proxyModel->categoryForRow(11), 2);
+    QCOMPARE(m_proxyModel->categoryForRow(12), -1);
+
+    QSignalSpy categoriesChangedSpy(m_proxyModel, &KCategorizedSortFilterProxyModel::categoriesChanged);
+    const auto lastChange = [&categoriesChangedSpy]() {
+        const QList<QVariant> arguments = categoriesChangedSpy.takeLast();
+        return std::pair(arguments.at(0).toInt(), arguments.at(1).toInt());
+    };
+
+    // a new category at the end
+    m_model->appendRow(createItem(qlonglong(3)));
+    QCOMPARE(categoriesChangedSpy.count(), 1);
+    QCOMPARE(lastChange(), std::pair(2, 3));
+    QCOMPARE(m_proxyModel->categoryCount(), 4);
+
+    // the first category gets smaller, the other ones only start earlier
+    m_model->removeRow(0);
+    QCOMPARE(categoriesChangedSpy.count(), 1);
+    QCOMPARE(lastChange(), std::pair(0, 0));
+    QCOMPARE(m_proxyModel->categoryAt(1).firstRow, 3);
+    QCOMPARE(m_proxyModel->categoryAt(3).firstRow, 11);
+
+    // a row moving from the first category to the last one
+    m_model->item(0)->setData(qlonglong(3), KCategorizedSortFilterProxyModel::CategorySortRole);
+    m_model->item(0)->setData(QStringLiteral("3"), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+    QVERIFY(!categoriesChangedSpy.isEmpty());
+    const auto [first, last] = lastChange();
+    QCOMPARE(first, 0);
+    QCOMPARE(last, m_proxyModel->categoryCount() - 1);
+    QCOMPARE(m_proxyModel->categoryCount(), 4);
+    QCOMPARE(m_proxyModel->categoryAt(0).count, 2);
+    QCOMPARE(m_proxyModel->categoryAt(3).count, 2);
+
+    m_model->clear();
+    QVERIFY(!categoriesChangedSpy.isEmpty());
+    QCOMPARE(lastChange(), std::pair(0, -1));
+    QCOMPARE(m_proxyModel->categoryCount(), 0);
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryKeys_data()
+{
+    QTest::addColumn<KCategorizedSortFilterProxyModel::SortMode>("sortMode");
+
+    QTest::newRow("standard") << KCategorizedSortFilterProxyModel::StandardSort;
+    QTest::newRow("parallel") << KCategorizedSortFilterProxyModel::ParallelSort;
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryKeys()
+{
+    QFETCH(KCategorizedSortFilterProxyModel::SortMode, sortMode);
+
+    // no category roles at all
+    for (int i = 0; i < 30; ++i) {
+        auto *item = new QStandardItem(QString::number(i));
+        item->setData(i * 7 % 30, Qt::DisplayRole);
+        item->setData(quint64(i % 3 == 0 ? 9 : i % 3), KindRole);
+        m_model->appendRow(item);
+    }
+
+    KeyedProxyModel proxyModel;
+    proxyModel.setCategorizedModel(true);
+    proxyModel.setSortMode(sortMode);
+    proxyModel.setSourceModel(m_model);
+    proxyModel.sort(0);
+
+    QCOMPARE(proxyModel.categoryCount(), 3);
+    QCOMPARE(proxyModel.categoryAt(0).display, QStringLiteral("Kind 1"));
+    QCOMPARE(proxyModel.categoryAt(0).sortKey.toULongLong(), 1);
+    QCOMPARE(proxyModel.categoryAt(1).display, QStringLiteral("Kind 2"));
+    QCOMPARE(proxyModel.categoryAt(2).display, QStringLiteral("Kind 9"));
+    QCOMPARE(proxyModel.categoryAt(2).count, 10);
+    // once per key, not once per row
+    QCOMPARE(proxyModel.categoryDisplayCalls, 3);
+    QCOMPARE(proxyModel.index(29, 0).data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString(), QStringLiteral("Kind 9"));
+    for (int row = 1; row < 10; ++row) {
+        QVERIFY(proxyModel.index(row - 1, 0).data().toInt() <= proxyModel.index(row, 0).data().toInt());
+    }
+
+    // a row changing kind moves to its new category
+    m_model->item(1)->setData(quint64(0), KindRole);
+    QCOMPARE(proxyModel.categoryCount(), 4);
+    QCOMPARE(proxyModel.categoryAt(0).display, QStringLiteral("Kind 0"));
+    QCOMPARE(proxyModel.categoryAt(0).count, 1);
+    QCOMPARE(proxyModel.categoryAt(1).count, 9);
+    QCOMPARE(proxyModel.mapToSource(proxyModel.index(0, 0)).row(), 1);
+    QCOMPARE(proxyModel.categoryDisplayCalls, 4);
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryFilter()
+{
+    for (int i = 0; i < 12; ++i) {
+        m_model->appendRow(createItem(qlonglong(i % 3)));
+    }
+    m_proxyModel->sort(0);
+    m_model->categorySortRoleCalls = 0;
+
+    QSignalSpy rowsRemovedSpy(m_proxyModel, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy rowsInsertedSpy(m_proxyModel, &QAbstractItemModel::rowsInserted);
+
+    // the rows of the category go at once
+    m_proxyModel->setCategoryAccepted(qlonglong(1), false);
+    QVERIFY(!m_proxyModel->isCategoryAccepted(qlonglong(1)));
+    QCOMPARE(m_proxyModel->rowCount(), 8);
+    QCOMPARE(rowsRemovedSpy.count(), 1);
+    QCOMPARE(rowsRemovedSpy.constFirst().at(1).toInt(), 4);
+    QCOMPARE(rowsRemovedSpy.constFirst().at(2).toInt(), 7);
+    // answered by the proxy's own sort keys
+    QCOMPARE(m_model->categorySortRoleCalls, 0);
+    QCOMPARE(m_proxyModel->categoryCount(), 2);
+    QCOMPARE(m_proxyModel->categoryAt(1).display, QStringLiteral("2"));
+
+    // and come back at once
+    m_proxyModel->setCategoryAccepted(qlonglong(1), true);
+    QCOMPARE(m_proxyModel->rowCount(), 12);
+    QCOMPARE(rowsInsertedSpy.count(), 1);
+    QCOMPARE(rowsInsertedSpy.constFirst().at(1).toInt(), 4);
+    QCOMPARE(rowsInsertedSpy.constFirst().at(2).toInt(), 7);
+    verifySorted();
+
+    // rows added to a hidden category stay hidden
+    m_proxyModel->setAcceptedCategories({qlonglong(2)});
+    QCOMPARE(m_proxyModel->rowCount(), 4);
+    QVERIFY(!m_proxyModel->isCategoryAccepted(qlonglong(0)));
+    m_model->appendRow(createItem(qlonglong(0)));
+    m_model->appendRow(createItem(qlonglong(2)));
+    QCOMPARE(m_proxyModel->rowCount(), 5);
+
+    m_proxyModel->clearCategoryFilter();
+    QCOMPARE(m_proxyModel->rowCount(), 14);
+    verifySorted();
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryFilterBeforeSorting()
+{
+    for (const QString &category : {QStringLiteral("b"), QStringLiteral("a"), QStringLiteral("c"), QStringLiteral("a")}) {
+        m_model->appendRow(createItem(category));
+    }
+
+    // the filter asks for the string keys before any sorting ranked them
+    m_proxyModel->setAcceptedCategories({QStringLiteral("a"), QStringLiteral("c")});
+    QCOMPARE(m_proxyModel->rowCount(), 3);
+
+    m_model->appendRow(createItem(QStringLiteral("a")));
+    m_model->appendRow(createItem(QStringLiteral("b")));
+    QCOMPARE(m_proxyModel->rowCount(), 4);
+
+    m_proxyModel->sort(0);
+    QStringList categories;
+    for (const QVariant &key : proxySortKeys()) {
+        categories << key.toString();
+    }
+    QCOMPARE(categories, (QStringList{QStringLiteral("a"), QStringLiteral("a"), QStringLiteral("a"), QStringLiteral("c")}));
+
+    m_model->appendRow(createItem(QStringLiteral("c")));
+    m_model->insertRow(0, createItem(QStringLiteral("a")));
+    QCOMPARE(m_proxyModel->rowCount(), 6);
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryAggregates()
+{
+    static const int SizeRole = Qt::UserRole + 2;
+    for (int i = 0; i < 12; ++i) {
+        QStandardItem *item = createItem(qlonglong(i % 3));
+        item->setData(i, SizeRole);
+        m_model->appendRow(item);
+    }
+    m_proxyModel->sort(0);
+    const int sum = m_proxyModel->addCategoryAggregate(KCategorizedSortFilterProxyModel::SumAggregate, SizeRole);
+    const int minimum = m_proxyModel->addCategoryAggregate(KCategorizedSortFilterProxyModel::MinimumAggregate, SizeRole);
+    const int maximum = m_proxyModel->addCategoryAggregate(KCategorizedSortFilterProxyModel::MaximumAggregate, SizeRole);
+
+    // category 1 has the sizes 1, 4, 7 and 10
+    QCOMPARE(m_proxyModel->categoryAggregate(1, sum), 22.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, minimum), 1.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, maximum), 10.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(3, sum), 0.0);
+
+    m_model->item(4)->setData(20, SizeRole);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, sum), 38.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, maximum), 20.0);
+
+    // removing the minimum
+    m_model->removeRow(1);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, sum), 37.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, minimum), 7.0);
+
+    QStandardItem *item = createItem(qlonglong(1));
+    item->setData(3, SizeRole);
+    m_model->appendRow(item);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, sum), 40.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, minimum), 3.0);
+
+    // a row moving from category 1 to category 2 takes its size along
+    const int row = m_model->indexFromItem(item).row();
+    m_model->item(row)->setData(qlonglong(2), KCategorizedSortFilterProxyModel::CategorySortRole);
+    m_model->item(row)->setData(QStringLiteral("2"), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+    QCOMPARE(m_proxyModel->categoryCount(), 3);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, sum), 37.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(1, minimum), 7.0);
+    QCOMPARE(m_proxyModel->categoryAggregate(2, sum), 2.0 + 5 + 8 + 11 + 3);
+    QCOMPARE(m_proxyModel->categoryAggregate(2, minimum), 2.0);
+
+    m_proxyModel->setCategoryAccepted(qlonglong(0), false);
+    QCOMPARE(m_proxyModel->categoryAggregate(0, sum), 37.0);
+
+    m_proxyModel->clearCategoryAggregates();
+    QCOMPARE(m_proxyModel->categoryAggregate(0, sum), 0.0);
+}
+
+void KCategorizedSortFilterProxyModelTest::testCategoryAggregatesAcrossInsertions()
+{
+    static const int SizeRole = Qt::UserRole + 2;
+    MapCountingProxyModel proxyModel;
+    proxyModel.setCategorizedModel(true);
+    proxyModel.setSourceModel(m_model);
+    for (int i = 0; i < 300; ++i) {
+        QStandardItem *item = createItem(qlonglong(i % 3), QString::number(1000 + i));
+        item->setData(i, SizeRole);
+        m_model->appendRow(item);
+    }
+    proxyModel.sort(0);
+    const int sum = proxyModel.addCategoryAggregate(KCategorizedSortFilterProxyModel::SumAggregate, SizeRole);
+    const int maximum = proxyModel.addCategoryAggregate(KCategorizedSortFilterProxyModel::MaximumAggregate, SizeRole);
+    double expectedSum = 0;
+    for (int i = 1; i < 300; i += 3) {
+        expectedSum += i;
+    }
+    QCOMPARE(proxyModel.categoryAggregate(1, sum), expectedSum);
+
+    // sorted into the middle of category 1
+    for (int i = 0; i < 5; ++i) {
+        QStandardItem *item = createItem(qlonglong(1), QString::number(1150 + i));
+        item->setData(1000 + i, SizeRole);
+        m_model->appendRow(item);
+        expectedSum += 1000 + i;
+    }
+    QCOMPARE(proxyModel.categoryCount(), 3);
+
+    // the aggregates were kept up to date, instead of computed again from every row
+    proxyModel.mapToSourceCalls = 0;
+    QCOMPARE(proxyModel.categoryAggregate(1, sum), expectedSum);
+    QCOMPARE(proxyModel.categoryAggregate(1, maximum), 1004.0);
+    QCOMPARE(proxyModel.mapToSourceCalls, 0);
+}
+
+QTEST_MAIN(KCategorizedSortFilterProxyModelTest)
+
+#include "kcategorizedsortfilterproxymodeltest.moc"
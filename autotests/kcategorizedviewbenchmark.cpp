@@ -0,0 +1,371 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <QAbstractListModel>
+#include <QApplication>
+#include <QImage>
+
+#include <kcategorizedsortfilterproxymodel.h>
+#include <kcategorizedview.h>
+#include <kcategorydrawer.h>
+
+#include <memory>
+
+enum ItemSizing {
+    GridSizing,
+    UniformSizing,
+    VariableSizing,
+};
+Q_DECLARE_METATYPE(ItemSizing)
+
+/*
+ * A flat model whose rows are already grouped by category, so it does not need to be sorted. It
+ * only stores two ints per row, so it can hold millions of them.
+ */
+class SyntheticModel : public QAbstractListModel
+{
+public:
+    SyntheticModel(int rowCount, int categoryCount, QObject *parent = nullptr)
+        : QAbstractListModel(parent)
+    {
+        m_rows.reserve(rowCount);
+        for (int i = 0; i < rowCount; ++i) {
+            m_rows.append({int(qint64(i) * categoryCount / rowCount), i});
+        }
+        m_nextId = rowCount;
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : m_rows.count();
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        const Row &row = m_rows.at(index.row());
+        switch (role) {
+        case Qt::DisplayRole:
+            // texts of different widths, for variable item sizes
+            return QString::number(quint64(row.id) * 2654435761u % 1000000);
+        case KCategorizedSortFilterProxyModel::CategoryDisplayRole:
+            return QStringLiteral("Category %1").arg(row.category, 5, 10, QLatin1Char('0'));
+        case KCategorizedSortFilterProxyModel::CategorySortRole:
+            return row.category;
+        }
+        return QVariant();
+    }
+
+    bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex()) override
+    {
+        if (parent.isValid() || row < 0 || row > m_rows.count() || count <= 0) {
+            return false;
+        }
+        // the new rows join the category of the row they are inserted at, so categories stay grouped
+        const int category = m_rows.isEmpty() ? 0 : m_rows.at(qMin(row, m_rows.count() - 1)).category;
+        beginInsertRows(parent, row, row + count - 1);
+        m_rows.insert(row, count, Row{category, 0});
+        for (int i = row; i < row + count; ++i) {
+            m_rows[i].id = m_nextId++;
+        }
+        endInsertRows();
+        return true;
+    }
+
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override
+    {
+        if (parent.isValid() || row < 0 || count <= 0 || row + count > m_rows.count()) {
+            return false;
+        }
+        beginRemoveRows(parent, row, row + count - 1);
+        m_rows.remove(row, count);
+        endRemoveRows();
+        return true;
+    }
+
+private:
+    struct Row {
+        int category;
+        int id;
+    };
+    QList<Row> m_rows;
+    int m_nextId = 0;
+};
+
+class BenchmarkView : public KCategorizedView
+{
+public:
+    using KCategorizedView::moveCursor;
+    using KCategorizedView::setSelection;
+
+    void relayout()
+    {
+        slotLayoutChanged();
+    }
+};
+
+class KCategorizedViewBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+
+    void benchmarkInitialLayout_data();
+    void benchmarkInitialLayout();
+    void benchmarkInsertRemoveRows_data();
+    void benchmarkInsertRemoveRows();
+    void benchmarkResize_data();
+    void benchmarkResize();
+    void benchmarkPaint_data();
+    void benchmarkPaint();
+    void benchmarkIndexAt_data();
+    void benchmarkIndexAt();
+    void benchmarkRubberBandSelection_data();
+    void benchmarkRubberBandSelection();
+    void benchmarkPageDown_data();
+    void benchmarkPageDown();
+
+private:
+    void addData(bool withInsertCounts = false);
+    void createView();
+    void layOutAll();
+
+    std::unique_ptr<BenchmarkView> m_view;
+    std::unique_ptr<KCategorizedSortFilterProxyModel> m_proxyModel;
+    std::unique_ptr<SyntheticModel> m_model;
+};
+
+void KCategorizedViewBenchmark::cleanup()
+{
+    m_view.reset();
+    m_proxyModel.reset();
+    m_model.reset();
+}
+
+void KCategorizedViewBenchmark::addData(bool withInsertCounts)
+{
+    QTest::addColumn<int>("rowCount");
+    QTest::addColumn<int>("categoryCount");
+    QTest::addColumn<ItemSizing>("itemSizing");
+    QTest::addColumn<Qt::LayoutDirection>("layoutDirection");
+    if (withInsertCounts) {
+        QTest::addColumn<int>("insertCount");
+    }
+
+    // allows a quick run on small models only, e.g. from ctest
+    const int maxRowCount = qEnvironmentVariableIsSet("KITEMVIEWS_BENCHMARK_MAX_ROWS") ? qEnvironmentVariableIntValue("KITEMVIEWS_BENCHMARK_MAX_ROWS") : 1000000;
+
+    const std::pair<ItemSizing, const char *> sizings[] = {{GridSizing, "grid"}, {UniformSizing, "uniform"}, {VariableSizing, "variable"}};
+    const std::pair<Qt::LayoutDirection, const char *> directions[] = {{Qt::LeftToRight, "LTR"}, {Qt::RightToLeft, "RTL"}};
+    for (int rowCount : {1000, 100000, 1000000}) {
+        if (rowCount > maxRowCount) {
+            continue;
+        }
+        for (int categoryCount : {1, 100, 10000}) {
+            if (categoryCount > rowCount / 10) {
+                continue;
+            }
+            for (const auto &[sizing, sizingName] : sizings) {
+                for (const auto &[direction, directionName] : directions) {
+                    const QByteArray tag = QByteArray::number(rowCount) + " rows, " + QByteArray::number(categoryCount) + " categories, " + sizingName + ", "
+                        + directionName;
+                    if (!withInsertCounts) {
+                        QTest::newRow(tag.constData()) << rowCount << categoryCount << sizing << direction;
+                        continue;
+                    }
+                    QTest::newRow((tag + ", single").constData()) << rowCount << categoryCount << sizing << direction << 1;
+                    QTest::newRow((tag + ", bulk").constData()) << rowCount << categoryCount << sizing << direction << qMin(rowCount / 10, 1000);
+                }
+            }
+        }
+    }
+}
+
+void KCategorizedViewBenchmark::createView()
+{
+    QFETCH(int, rowCount);
+    QFETCH(int, categoryCount);
+    QFETCH(ItemSizing, itemSizing);
+    QFETCH(Qt::LayoutDirection, layoutDirection);
+
+    m_model = std::make_unique<SyntheticModel>(rowCount, categoryCount);
+    m_proxyModel = std::make_unique<KCategorizedSortFilterProxyModel>();
+    m_proxyModel->setCategorizedModel(true);
+    m_proxyModel->setSourceModel(m_model.get());
+
+    m_view = std::make_unique<BenchmarkView>();
+    m_view->setCategoryDrawer(new KCategoryDrawer(m_view.get()));
+    m_view->setViewMode(QListView::IconMode);
+    m_view->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_view->setLayoutDirection(layoutDirection);
+    switch (itemSizing) {
+    case GridSizing:
+        m_view->setGridSize(QSize(96, 64));
+        break;
+    case UniformSizing:
+        m_view->setUniformItemSizes(true);
+        break;
+    case VariableSizing:
+        break;
+    }
+    m_view->resize(800, 600);
+    m_view->setModel(m_proxyModel.get());
+    m_view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_view.get()));
+}
+
+void KCategorizedViewBenchmark::layOutAll()
+{
+    // the view places items lazily, when their rect is asked for. With grid or uniform sizes the
+    // rect of an item does not depend on the previous ones, so every item is asked for.
+    const int rowCount = m_proxyModel->rowCount();
+    for (int row = 0; row < rowCount; ++row) {
+        m_view->visualRect(m_proxyModel->index(row, 0));
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkInitialLayout_data()
+{
+    addData();
+}
+
+void KCategorizedViewBenchmark::benchmarkInitialLayout()
+{
+    createView();
+
+    QBENCHMARK {
+        m_view->relayout();
+        layOutAll();
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkInsertRemoveRows_data()
+{
+    addData(true);
+}
+
+void KCategorizedViewBenchmark::benchmarkInsertRemoveRows()
+{
+    QFETCH(int, insertCount);
+    createView();
+    layOutAll();
+
+    const int row = m_model->rowCount() / 2;
+    QBENCHMARK {
+        m_model->insertRows(row, insertCount);
+        layOutAll();
+        m_model->removeRows(row, insertCount);
+        layOutAll();
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkResize_data()
+{
+    addData();
+}
+
+void KCategorizedViewBenchmark::benchmarkResize()
+{
+    createView();
+    layOutAll();
+
+    bool narrow = false;
+    QBENCHMARK {
+        narrow = !narrow;
+        m_view->resize(narrow ? 500 : 800, 600);
+        layOutAll();
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkPaint_data()
+{
+    addData();
+}
+
+void KCategorizedViewBenchmark::benchmarkPaint()
+{
+    createView();
+    layOutAll();
+
+    QWidget *viewport = m_view->viewport();
+    QImage image(viewport->size(), QImage::Format_ARGB32_Premultiplied);
+    QBENCHMARK {
+        image.fill(Qt::transparent);
+        viewport->render(&image);
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkIndexAt_data()
+{
+    addData();
+}
+
+void KCategorizedViewBenchmark::benchmarkIndexAt()
+{
+    createView();
+    layOutAll();
+
+    const QRect rect = m_view->viewport()->rect();
+    QBENCHMARK {
+        for (int y = rect.top(); y < rect.bottom(); y += 16) {
+            for (int x = rect.left(); x < rect.right(); x += 16) {
+                m_view->indexAt(QPoint(x, y));
+            }
+        }
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkRubberBandSelection_data()
+{
+    addData();
+}
+
+void KCategorizedViewBenchmark::benchmarkRubberBandSelection()
+{
+    createView();
+    layOutAll();
+
+    const QRect rect = m_view->viewport()->rect().adjusted(10, 10, -10, -10);
+    QBENCHMARK {
+        m_view->setSelection(rect, QItemSelectionModel::ClearAndSelect);
+    }
+}
+
+void KCategorizedViewBenchmark::benchmarkPageDown_data()
+{
+    addData();
+}
+
+void KCategorizedViewBenchmark::benchmarkPageDown()
+{
+    createView();
+    layOutAll();
+
+    const QModelIndex first = m_proxyModel->index(0, 0);
+    QBENCHMARK {
+        m_view->setCurrentIndex(first);
+        for (int i = 0; i < 20; ++i) {
+            m_view->setCurrentIndex(m_view->moveCursor(QAbstractItemView::MovePageDown, Qt::NoModifier));
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // the benchmarks do not need a display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QTEST_DISABLE_KEYPAD_NAVIGATION
+    KCategorizedViewBenchmark benchmark;
+    QTEST_SET_MAIN_SOURCE_PATH
+    return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "kcategorizedviewbenchmark.moc"
@@ -0,0 +1,322 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <QRandomGenerator>
+#include <QScrollBar>
+#include <QStandardItemModel>
+
+#include <kcategorizedsortfilterproxymodel.h>
+#include <kcategorizedview.h>
+#include <kcategorydrawer.h>
+
+#include <memory>
+
+static const int OrderRole = Qt::UserRole + 1;
+static const int CategoryCount = 6;
+
+/*
+ * One step of a sequence. The operands are reduced modulo the size of the model when the step is
+ * applied, so any subsequence of a valid sequence is valid too, which is what shrinking relies on.
+ */
+struct Step {
+    enum Kind {
+        Insert,
+        Remove,
+        Move,
+        ChangeOrder,
+        ChangeCategory,
+        ChangeText,
+        Resize,
+    };
+
+    Kind kind;
+    int a;
+    int b;
+    int c;
+
+    QString toString() const
+    {
+        static const char *const names[] = {"insert", "remove", "move", "change order", "change category", "change text", "resize"};
+        return QStringLiteral("%1(%2, %3, %4)").arg(QLatin1String(names[kind])).arg(a).arg(b).arg(c);
+    }
+};
+
+/*
+ * QStandardItemModel does not implement moveRows(). The rows are moved by rotating their data
+ * between beginMoveRows() and endMoveRows(), so the model reports a move rather than changed data.
+ * Like any QSortFilterProxyModel, the proxy passes it on to the views as a layout change.
+ */
+class MovableModel : public QStandardItemModel
+{
+public:
+    bool moveRows(const QModelIndex &sourceParent, int sourceRow, int count, const QModelIndex &destinationParent, int destinationChild) override
+    {
+        if (sourceParent.isValid() || destinationParent.isValid() || count <= 0 || sourceRow < 0 || sourceRow + count > rowCount() || destinationChild < 0
+            || destinationChild > rowCount()) {
+            return false;
+        }
+        if (!beginMoveRows(sourceParent, sourceRow, sourceRow + count - 1, destinationParent, destinationChild)) {
+            return false;
+        }
+
+        const int first = qMin(sourceRow, destinationChild);
+        const int last = qMax(sourceRow + count, destinationChild) - 1;
+        // where the first moved row ends up
+        const int destination = destinationChild > sourceRow ? destinationChild - count : destinationChild;
+        QList<QMap<int, QVariant>> rows;
+        for (int row = first; row <= last; ++row) {
+            rows << itemData(index(row, 0));
+        }
+        const QList<QMap<int, QVariant>> moved = rows.mid(sourceRow - first, count);
+        rows.remove(sourceRow - first, count);
+        for (int i = 0; i < count; ++i) {
+            rows.insert(destination - first + i, moved.at(i));
+        }
+
+        const bool wasBlocked = blockSignals(true);
+        for (int row = first; row <= last; ++row) {
+            setItemData(index(row, 0), rows.at(row - first));
+        }
+        blockSignals(wasBlocked);
+        endMoveRows();
+        return true;
+    }
+};
+
+class KCategorizedViewFuzzTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testIncrementalLayout_data();
+    void testIncrementalLayout();
+
+private:
+    enum ItemSizing {
+        GridSizing,
+        UniformSizing,
+        VariableSizing,
+    };
+
+    static QList<Step> randomSteps(quint32 seed, int count);
+    static QStandardItem *createItem(int category, int order, int textLength);
+    static void applyStep(const Step &step, MovableModel *model, KCategorizedView *view);
+
+    /*
+     * Runs \a steps on a fresh model, and returns a description of the first mismatch between the
+     * incrementally updated view and a view created after the step, or an empty string if there
+     * was none.
+     */
+    QString run(const QList<Step> &steps, ItemSizing itemSizing);
+
+    /*
+     * Returns a subsequence of \a steps, failing with the same sizing, from which no step can be
+     * removed without the failure going away.
+     */
+    QList<Step> shrink(QList<Step> steps, ItemSizing itemSizing);
+};
+
+QList<Step> KCategorizedViewFuzzTest::randomSteps(quint32 seed, int count)
+{
+    QRandomGenerator generator(seed);
+    QList<Step> steps;
+    steps.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        steps.append({Step::Kind(generator.bounded(Step::Resize + 1)), int(generator.bounded(1000)), int(generator.bounded(1000)), int(generator.bounded(1000))});
+    }
+    return steps;
+}
+
+QStandardItem *KCategorizedViewFuzzTest::createItem(int category, int order, int textLength)
+{
+    auto *item = new QStandardItem(QString(textLength, QLatin1Char('x')));
+    item->setData(QStringLiteral("Category %1").arg(category), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+    item->setData(category, KCategorizedSortFilterProxyModel::CategorySortRole);
+    item->setData(order, OrderRole);
+    return item;
+}
+
+void KCategorizedViewFuzzTest::applyStep(const Step &step, MovableModel *model, KCategorizedView *view)
+{
+    const int rowCount = model->rowCount();
+    if (rowCount == 0 && step.kind != Step::Insert && step.kind != Step::Resize) {
+        return;
+    }
+
+    switch (step.kind) {
+    case Step::Insert: {
+        const int row = step.a % (rowCount + 1);
+        const int count = 1 + step.b % 4;
+        QList<QStandardItem *> items;
+        for (int i = 0; i < count; ++i) {
+            items << createItem(step.c % CategoryCount, (step.b + 7 * i) % 100, 1 + (step.a + i) % 12);
+        }
+        if (count == 1) {
+            model->insertRow(row, items.constFirst());
+        } else {
+            // inserting an empty range and filling it emits rowsInserted for all of them at once
+            model->insertRows(row, count);
+            for (int i = 0; i < count; ++i) {
+                model->setItem(row + i, items.at(i));
+            }
+        }
+        break;
+    }
+    case Step::Remove: {
+        const int row = step.a % rowCount;
+        model->removeRows(row, qMin(1 + step.b % 4, rowCount - row));
+        break;
+    }
+    case Step::Move: {
+        const int row = step.a % rowCount;
+        const int count = qMin(1 + step.b % 4, rowCount - row);
+        // a destination inside the moved range is rejected, which is a valid step too
+        model->moveRows(QModelIndex(), row, count, QModelIndex(), step.c % (rowCount + 1));
+        break;
+    }
+    case Step::ChangeOrder:
+        model->item(step.a % rowCount)->setData(step.b % 100, OrderRole);
+        break;
+    case Step::ChangeCategory: {
+        const int category = step.c % CategoryCount;
+        model->setItemData(model->index(step.a % rowCount, 0),
+                           {{KCategorizedSortFilterProxyModel::CategoryDisplayRole, QStringLiteral("Category %1").arg(category)},
+                            {KCategorizedSortFilterProxyModel::CategorySortRole, category}});
+        break;
+    }
+    case Step::ChangeText:
+        model->item(step.a % rowCount)->setText(QString(1 + step.b % 12, QLatin1Char('x')));
+        break;
+    case Step::Resize: {
+        view->resize(200 + step.a % 400, 300);
+        break;
+    }
+    }
+}
+
+QString KCategorizedViewFuzzTest::run(const QList<Step> &steps, ItemSizing itemSizing)
+{
+    MovableModel model;
+    for (int i = 0; i < 30; ++i) {
+        model.appendRow(createItem(i % 4, (i * 37) % 100, 1 + i % 12));
+    }
+    KCategorizedSortFilterProxyModel proxyModel;
+    proxyModel.setCategorizedModel(true);
+    proxyModel.setSortRole(OrderRole);
+    proxyModel.setSourceModel(&model);
+    proxyModel.sort(0);
+
+    const auto setUpView = [&proxyModel, itemSizing](KCategorizedView *view) {
+        view->setCategoryDrawer(new KCategoryDrawer(view));
+        view->setViewMode(QListView::IconMode);
+        // so the viewport width does not depend on how far the layout went
+        view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+        if (itemSizing == GridSizing) {
+            view->setGridSize(QSize(60, 40));
+        } else if (itemSizing == UniformSizing) {
+            view->setUniformItemSizes(true);
+        }
+        view->setModel(&proxyModel);
+        view->show();
+    };
+    KCategorizedView view;
+    view.resize(300, 300);
+    setUpView(&view);
+    if (!QTest::qWaitForWindowExposed(&view)) {
+        return QStringLiteral("the view could not be shown");
+    }
+
+    // in content coordinates, the views are not necessarily scrolled to the same position
+    const auto contentRect = [](KCategorizedView *categorizedView, const QModelIndex &index) {
+        return categorizedView->visualRect(index).translated(0, categorizedView->verticalScrollBar()->value());
+    };
+    for (int i = 0; i < steps.count(); ++i) {
+        applyStep(steps.at(i), &model, &view);
+
+        // lays out everything from scratch, sharing no state with the view under test
+        KCategorizedView freshView;
+        freshView.resize(view.size());
+        setUpView(&freshView);
+        if (!QTest::qWaitForWindowExposed(&freshView)) {
+            return QStringLiteral("the fresh view could not be shown");
+        }
+        for (int row = 0; row < proxyModel.rowCount(); ++row) {
+            const QModelIndex index = proxyModel.index(row, 0);
+            const QRect incremental = contentRect(&view, index);
+            const QRect fresh = contentRect(&freshView, index);
+            if (incremental != fresh) {
+                QString message;
+                QDebug(&message).nospace() << "after step " << i << ", row " << row << " is at " << incremental << " instead of " << fresh;
+                return message;
+            }
+        }
+    }
+    return QString();
+}
+
+QList<Step> KCategorizedViewFuzzTest::shrink(QList<Step> steps, ItemSizing itemSizing)
+{
+    // removes chunks of halving sizes for as long as the sequence keeps failing
+    bool shrunk = true;
+    while (shrunk) {
+        shrunk = false;
+        for (int chunk = qMax(steps.count() / 2, 1); chunk >= 1; chunk /= 2) {
+            for (int i = 0; i + chunk <= steps.count();) {
+                QList<Step> candidate = steps;
+                candidate.remove(i, chunk);
+                if (!run(candidate, itemSizing).isEmpty()) {
+                    steps = candidate;
+                    shrunk = true;
+                } else {
+                    i += chunk;
+                }
+            }
+        }
+    }
+    return steps;
+}
+
+void KCategorizedViewFuzzTest::testIncrementalLayout_data()
+{
+    QTest::addColumn<int>("itemSizing");
+
+    QTest::newRow("grid") << int(GridSizing);
+    QTest::newRow("uniform sizes") << int(UniformSizing);
+    QTest::newRow("variable sizes") << int(VariableSizing);
+}
+
+void KCategorizedViewFuzzTest::testIncrementalLayout()
+{
+    QFETCH(int, itemSizing);
+
+    // KITEMVIEWS_FUZZ_SEED replays a single sequence
+    const bool replay = qEnvironmentVariableIsSet("KITEMVIEWS_FUZZ_SEED");
+    const quint32 firstSeed = replay ? quint32(qEnvironmentVariableIntValue("KITEMVIEWS_FUZZ_SEED")) : 1;
+    const quint32 seedCount = replay ? 1 : 20;
+    for (quint32 seed = firstSeed; seed < firstSeed + seedCount; ++seed) {
+        QList<Step> steps = randomSteps(seed, 40);
+        const QString failure = run(steps, ItemSizing(itemSizing));
+        if (failure.isEmpty()) {
+            continue;
+        }
+
+        steps = shrink(steps, ItemSizing(itemSizing));
+        QStringList stepNames;
+        for (const Step &step : std::as_const(steps)) {
+            stepNames << step.toString();
+        }
+        const QString message = QStringLiteral("seed %1: %2\nminimal sequence, %3: %4")
+                                    .arg(seed)
+                                    .arg(failure, run(steps, ItemSizing(itemSizing)), stepNames.join(QLatin1String(", ")));
+        QFAIL(qPrintable(message));
+    }
+}
+
+QTEST_MAIN(KCategorizedViewFuzzTest)
+
+#include "kcategorizedviewfuzztest.moc"
@@ -0,0 +1,110 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kcategorizedviewlayout_p.h>
+
+class KCategorizedViewLayoutTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testGrid();
+    void testGridRightToLeft();
+    void testUniform();
+    void testVariableWrapsAfterHighestItem();
+    void testVariableTopToBottom();
+
+private:
+    static KCategorizedViewLayout::Parameters parameters(KCategorizedViewLayout::ItemSizing itemSizing);
+};
+
+KCategorizedViewLayout::Parameters KCategorizedViewLayoutTest::parameters(KCategorizedViewLayout::ItemSizing itemSizing)
+{
+    KCategorizedViewLayout::Parameters parameters;
+    parameters.itemSizing = itemSizing;
+    parameters.gridSize = QSize(100, 50);
+    parameters.spacing = 2;
+    parameters.categorySpacing = 5;
+    parameters.leftMargin = 3;
+    parameters.viewportWidth = 310;
+    return parameters;
+}
+
+void KCategorizedViewLayoutTest::testGrid()
+{
+    const KCategorizedViewLayout layout(parameters(KCategorizedViewLayout::GridSizing));
+    QList<KCategorizedViewLayout::Item> items(4);
+    for (int i = 0; i < items.count(); ++i) {
+        layout.placeItem(items.data(), i, QSize(20, 20));
+    }
+
+    // three columns fit in the viewport, the fourth item goes to the second row
+    QCOMPARE(items[0].topLeft, QPoint(8, 0));
+    QCOMPARE(items[2].topLeft, QPoint(208, 0));
+    QCOMPARE(items[3].topLeft, QPoint(8, 50));
+    QCOMPARE(items[3].size, QSize(20, 20));
+}
+
+void KCategorizedViewLayoutTest::testGridRightToLeft()
+{
+    KCategorizedViewLayout::Parameters p = parameters(KCategorizedViewLayout::GridSizing);
+    p.layoutDirection = Qt::RightToLeft;
+    const KCategorizedViewLayout layout(p);
+    QList<KCategorizedViewLayout::Item> items(2);
+    layout.placeItem(items.data(), 0, QSize(20, 20));
+    layout.placeItem(items.data(), 1, QSize(20, 20));
+
+    QCOMPARE(items[0].topLeft, QPoint(310 - 100 + 8, 0));
+    QCOMPARE(items[1].topLeft, QPoint(310 - 200 + 8, 0));
+}
+
+void KCategorizedViewLayoutTest::testUniform()
+{
+    const KCategorizedViewLayout layout(parameters(KCategorizedViewLayout::UniformSizing));
+    QList<KCategorizedViewLayout::Item> items(5);
+    for (int i = 0; i < items.count(); ++i) {
+        layout.placeItem(items.data(), i, QSize(70, 30));
+    }
+
+    // (310 - 2) / (70 + 2) = 4 items per row
+    QCOMPARE(items[1].topLeft, QPoint(78, 0));
+    QCOMPARE(items[4].topLeft, QPoint(8, 30));
+}
+
+void KCategorizedViewLayoutTest::testVariableWrapsAfterHighestItem()
+{
+    const KCategorizedViewLayout layout(parameters(KCategorizedViewLayout::VariableSizing));
+    QList<KCategorizedViewLayout::Item> items(3);
+    layout.placeItem(items.data(), 0, QSize(100, 40));
+    layout.placeItem(items.data(), 1, QSize(100, 20));
+    layout.placeItem(items.data(), 2, QSize(150, 20));
+
+    QCOMPARE(items[0].topLeft, QPoint(10, 2));
+    QCOMPARE(items[1].topLeft, QPoint(112, 2));
+    // does not fit in the first row, and has to be placed under the highest item of it
+    QCOMPARE(items[2].topLeft, QPoint(10, 2 + 40 + 2));
+    QCOMPARE(items[2].size, QSize(150, 20));
+}
+
+void KCategorizedViewLayoutTest::testVariableTopToBottom()
+{
+    KCategorizedViewLayout::Parameters p = parameters(KCategorizedViewLayout::VariableSizing);
+    p.flow = QListView::TopToBottom;
+    const KCategorizedViewLayout layout(p);
+    QList<KCategorizedViewLayout::Item> items(2);
+    layout.placeItem(items.data(), 0, QSize(100, 40));
+    layout.placeItem(items.data(), 1, QSize(100, 20));
+
+    QCOMPARE(items[0].topLeft, QPoint(10, 2));
+    QCOMPARE(items[1].topLeft, QPoint(10, 44));
+    QCOMPARE(items[1].size, QSize(310, 20));
+}
+
+QTEST_MAIN(KCategorizedViewLayoutTest)
+
+#include "kcategorizedviewlayouttest.moc"
@@ -0,0 +1,558 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScrollBar>
+#include <QSignalSpy>
+#include <QStandardItemModel>
+#include <QStyledItemDelegate>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <kcategorizedsortfilterproxymodel.h>
+#include <kcategorizedview.h>
+#include <kcategorydrawer.h>
+#include <kitemviewsinstrumentation.h>
+
+static const int SecondarySortRole = Qt::UserRole + 1;
+
+class LazyModel : public QStandardItemModel
+{
+public:
+    using QStandardItemModel::QStandardItemModel;
+
+    bool canFetchMore(const QModelIndex &parent) const override
+    {
+        return !parent.isValid() && rowCount() < 200;
+    }
+
+    void fetchMore(const QModelIndex &parent) override
+    {
+        if (!canFetchMore(parent)) {
+            return;
+        }
+        for (int i = 0; i < 20; ++i) {
+            const int row = rowCount();
+            auto *item = new QStandardItem(QString::number(row));
+            item->setData(QStringLiteral("Category %1").arg(row / 30, 2, 10, QLatin1Char('0')), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+            item->setData(row / 30, KCategorizedSortFilterProxyModel::CategorySortRole);
+            appendRow(item);
+        }
+    }
+};
+
+class SlowDelegate : public QStyledItemDelegate
+{
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        QThread::msleep(5);
+        paintedRows.insert(index.row());
+        ++paintCounts[index.row()];
+        QStyledItemDelegate::paint(painter, option, index);
+    }
+
+    mutable QSet<int> paintedRows;
+    mutable QHash<int, int> paintCounts;
+};
+
+class KCategorizedViewTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testSortInsideCategories_data();
+    void testSortInsideCategories();
+    void testSortReorderingCategories();
+    void testFetchMore();
+    void testPaintBudget();
+    void testPaintBudgetProgress();
+    void testAsynchronousLayout();
+    void testMemoryUsage();
+    void testInstrumentation();
+    void testBlockRange();
+    void testCategoryChangeMovesRow_data();
+    void testCategoryChangeMovesRow();
+    void testLayoutStateRoundTrip();
+    void testLayoutStateRejected_data();
+    void testLayoutStateRejected();
+    void testLayoutStateRowCountChanged();
+    void testLargeVariableSizeBlock();
+
+private:
+    KCategorizedView *createView();
+    void compareWithFreshView(KCategorizedView *view);
+
+    QStandardItemModel *m_model = nullptr;
+    KCategorizedSortFilterProxyModel *m_proxyModel = nullptr;
+    QList<KCategorizedView *> m_views;
+};
+
+void KCategorizedViewTest::init()
+{
+    m_model = new QStandardItemModel(this);
+    for (int i = 0; i < 60; ++i) {
+        auto *item = new QStandardItem(QString::number(i % 10).repeated(1 + (i % 3)));
+        item->setData(QStringLiteral("Category %1").arg(i / 10), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+        item->setData(i / 10, KCategorizedSortFilterProxyModel::CategorySortRole);
+        item->setData(100 - i, SecondarySortRole);
+        m_model->appendRow(item);
+    }
+
+    m_proxyModel = new KCategorizedSortFilterProxyModel(this);
+    m_proxyModel->setCategorizedModel(true);
+    m_proxyModel->setSourceModel(m_model);
+    m_proxyModel->sort(0);
+}
+
+void KCategorizedViewTest::cleanup()
+{
+    qDeleteAll(m_views);
+    m_views.clear();
+    delete m_proxyModel;
+    delete m_model;
+}
+
+KCategorizedView *KCategorizedViewTest::createView()
+{
+    auto *view = new KCategorizedView;
+    view->setCategoryDrawer(new KCategoryDrawer(view));
+    view->setViewMode(QListView::IconMode);
+    view->resize(300, 400);
+    view->setModel(m_proxyModel);
+    m_views << view;
+    return view;
+}
+
+void KCategorizedViewTest::compareWithFreshView(KCategorizedView *view)
+{
+    KCategorizedView *freshView = createView();
+    freshView->setUniformItemSizes(view->uniformItemSizes());
+    freshView->resize(view->size());
+    if (view->isVisible()) {
+        freshView->show();
+        QVERIFY(QTest::qWaitForWindowExposed(freshView));
+        QCOMPARE(freshView->viewport()->width(), view->viewport()->width());
+    }
+
+    // in content coordinates, the views are not necessarily scrolled to the same position
+    const auto contentRect = [](KCategorizedView *categorizedView, const QModelIndex &index) {
+        return categorizedView->visualRect(index).translated(0, categorizedView->verticalScrollBar()->value());
+    };
+    for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+        const QModelIndex index = m_proxyModel->index(row, 0);
+        QCOMPARE(contentRect(view, index), contentRect(freshView, index));
+    }
+    QCOMPARE(view->block(QStringLiteral("Category 0")), freshView->block(QStringLiteral("Category 0")));
+}
+
+void KCategorizedViewTest::testSortInsideCategories_data()
+{
+    QTest::addColumn<bool>("uniformItemSizes");
+
+    QTest::newRow("variable sizes") << false;
+    QTest::newRow("uniform sizes") << true;
+}
+
+void KCategorizedViewTest::testSortInsideCategories()
+{
+    QFETCH(bool, uniformItemSizes);
+
+    KCategorizedView *view = createView();
+    view->setUniformItemSizes(uniformItemSizes);
+    const QString firstDisplay = m_proxyModel->index(0, 0).data(Qt::DisplayRole).toString();
+    view->visualRect(m_proxyModel->index(m_proxyModel->rowCount() - 1, 0));
+
+    // the secondary role reverses the rows inside each category
+    m_proxyModel->setSortRole(SecondarySortRole);
+    QVERIFY(m_proxyModel->index(0, 0).data(Qt::DisplayRole).toString() != firstDisplay);
+    QCOMPARE(m_proxyModel->index(0, 0).data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString(), QStringLiteral("Category 0"));
+
+    compareWithFreshView(view);
+}
+
+void KCategorizedViewTest::testSortReorderingCategories()
+{
+    KCategorizedView *view = createView();
+    view->visualRect(m_proxyModel->index(m_proxyModel->rowCount() - 1, 0));
+
+    m_proxyModel->sort(0, Qt::DescendingOrder);
+    QCOMPARE(m_proxyModel->index(0, 0).data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString(), QStringLiteral("Category 5"));
+
+    compareWithFreshView(view);
+}
+
+void KCategorizedViewTest::testFetchMore()
+{
+    delete m_proxyModel;
+    delete m_model;
+    m_model = new LazyModel(this);
+    m_proxyModel = new KCategorizedSortFilterProxyModel(this);
+    m_proxyModel->setCategorizedModel(true);
+    m_proxyModel->setSourceModel(m_model);
+
+    KCategorizedView *view = createView();
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+
+    // batches are requested until there is more than a page of content below the viewport
+    QTRY_VERIFY(m_model->rowCount() > 20);
+    QVERIFY(m_model->canFetchMore(QModelIndex()));
+    const int fetchedRows = m_model->rowCount();
+
+    // and the next ones when scrolling towards the end
+    view->verticalScrollBar()->setValue(view->verticalScrollBar()->maximum());
+    QTRY_VERIFY(m_model->rowCount() > fetchedRows);
+
+    compareWithFreshView(view);
+}
+
+void KCategorizedViewTest::testPaintBudget()
+{
+    KCategorizedView *view = createView();
+    auto *delegate = new SlowDelegate(view);
+    view->setItemDelegate(delegate);
+    view->setPaintBudget(1);
+    QCOMPARE(view->paintBudget(), 1);
+    QSignalSpy paintCompletedSpy(view, &KCategorizedView::paintCompleted);
+
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+
+    // only one item is painted for real per paint, the rest follow on later paints
+    const auto allVisibleItemsPainted = [view, delegate, this]() {
+        for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+            const QModelIndex index = m_proxyModel->index(row, 0);
+            if (view->viewport()->rect().intersects(view->visualRect(index)) && !delegate->paintedRows.contains(row)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    QTRY_VERIFY(allVisibleItemsPainted());
+    QVERIFY(delegate->paintedRows.count() > 1);
+    QTRY_VERIFY(!paintCompletedSpy.isEmpty());
+}
+
+void KCategorizedViewTest::testPaintBudgetProgress()
+{
+    // several items per line, each follow-up paint has items painted already next to it
+    KCategorizedView *view = createView();
+    view->resize(600, 400);
+    auto *delegate = new SlowDelegate(view);
+    view->setItemDelegate(delegate);
+    view->setPaintBudget(1);
+    QSignalSpy paintCompletedSpy(view, &KCategorizedView::paintCompleted);
+
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+    QTRY_VERIFY(!paintCompletedSpy.isEmpty());
+
+    QList<int> visibleRows;
+    for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+        if (view->viewport()->rect().intersects(view->visualRect(m_proxyModel->index(row, 0)))) {
+            visibleRows << row;
+        }
+    }
+    QVERIFY(visibleRows.count() > 1);
+    for (int row : std::as_const(visibleRows)) {
+        QVERIFY2(delegate->paintedRows.contains(row), qPrintable(QStringLiteral("row %1 was not painted").arg(row)));
+    }
+
+    // the follow-up paints made progress and stopped, instead of painting the same items over
+    // and over
+    const QHash<int, int> paintCounts = delegate->paintCounts;
+    QTest::qWait(100);
+    QCOMPARE(delegate->paintCounts, paintCounts);
+}
+
+void KCategorizedViewTest::testAsynchronousLayout()
+{
+    KCategorizedView *view = createView();
+    view->setAsynchronousLayout(true);
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+
+    const QModelIndex lastIndex = m_proxyModel->index(m_proxyModel->rowCount() - 1, 0);
+    const QRect lastRect = view->visualRect(lastIndex);
+
+    // a narrower viewport fits less items per row
+    view->resize(view->width() / 2, view->height());
+    QTRY_VERIFY(view->visualRect(lastIndex).bottom() > lastRect.bottom());
+
+    compareWithFreshView(view);
+}
+
+void KCategorizedViewTest::testMemoryUsage()
+{
+    KCategorizedView *view = createView();
+    view->visualRect(m_proxyModel->index(0, 0));
+
+    const auto find = [](const QList<KItemViewsMemoryUsage> &usage, const QString &structure) {
+        for (const KItemViewsMemoryUsage &entry : usage) {
+            if (entry.structure == structure) {
+                return entry;
+            }
+        }
+        return KItemViewsMemoryUsage();
+    };
+    const QList<KItemViewsMemoryUsage> usage = view->memoryUsage();
+    QCOMPARE(find(usage, QStringLiteral("blocks")).elements, qsizetype(6));
+    QCOMPARE(find(usage, QStringLiteral("block items")).elements, qsizetype(60));
+    QVERIFY(find(usage, QStringLiteral("block items")).bytes >= 60 * qsizetype(sizeof(QPoint) + sizeof(QSize)));
+    QCOMPARE(find(usage, QStringLiteral("category runs")).elements, qsizetype(6));
+
+    m_model->removeRows(0, 10);
+    QCOMPARE(find(view->memoryUsage(), QStringLiteral("blocks")).elements, qsizetype(5));
+}
+
+void KCategorizedViewTest::testInstrumentation()
+{
+    KItemViewsInstrumentation::setEnabled(true);
+    KItemViewsInstrumentation::resetCounters();
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString traceFileName = dir.filePath(QStringLiteral("trace.json"));
+    QVERIFY(KItemViewsInstrumentation::startTrace(traceFileName));
+
+    KCategorizedView *view = createView();
+    const QModelIndex index = m_proxyModel->index(0, 0);
+    view->visualRect(index);
+    const qint64 misses = KItemViewsInstrumentation::counter(KItemViewsInstrumentation::VisualRectMisses);
+    QVERIFY(misses > 0);
+    view->visualRect(index);
+    QVERIFY(KItemViewsInstrumentation::counter(KItemViewsInstrumentation::VisualRectHits) > 0);
+    QCOMPARE(KItemViewsInstrumentation::counter(KItemViewsInstrumentation::VisualRectMisses), misses);
+    QVERIFY(KItemViewsInstrumentation::counter(KItemViewsInstrumentation::LayoutSweeps) > 0);
+
+    view->grab();
+    QVERIFY(KItemViewsInstrumentation::counter(KItemViewsInstrumentation::Paints) > 0);
+
+    KItemViewsInstrumentation::stopTrace();
+    KItemViewsInstrumentation::setEnabled(false);
+
+    QFile traceFile(traceFileName);
+    QVERIFY(traceFile.open(QIODevice::ReadOnly));
+    QJsonParseError error;
+    const QJsonArray events = QJsonDocument::fromJson(traceFile.readAll(), &error).array();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QStringList names;
+    for (const QJsonValue &event : events) {
+        names << event.toObject().value(QStringLiteral("name")).toString();
+    }
+    QVERIFY(names.contains(QStringLiteral("KCategorizedView::paintEvent")));
+    QCOMPARE(names.constLast(), QStringLiteral("counters"));
+    QVERIFY(events.last().toObject().value(QStringLiteral("args")).toObject().value(QStringLiteral("paints")).toInteger() > 0);
+}
+
+void KCategorizedViewTest::testBlockRange()
+{
+    KCategorizedView *view = createView();
+
+    // nothing was laid out yet
+    QVERIFY(view->block(QStringLiteral("Category 2")).isEmpty());
+    QCOMPARE(view->blockCount(), 6);
+    QCOMPARE(view->blockCategory(2), QStringLiteral("Category 2"));
+    QCOMPARE(view->blockCategory(6), QString());
+
+    KCategorizedView::BlockRange range = view->blockRangeAt(2);
+    QVERIFY(range.isValid());
+    QCOMPARE(range.firstRow, 20);
+    QCOMPARE(range.count, 10);
+    QCOMPARE(range.ordinal, 2);
+    QVERIFY(!range.collapsed);
+    QVERIFY(!view->blockRangeAt(6).isValid());
+
+    range = view->blockRange(m_proxyModel->index(45, 0));
+    QCOMPARE(range.firstRow, 40);
+    QCOMPARE(range.ordinal, 4);
+    QVERIFY(!view->blockRange(QStringLiteral("Category 9")).isValid());
+
+    // the ranges agree with the blocks, once there are some
+    view->visualRect(m_proxyModel->index(m_proxyModel->rowCount() - 1, 0));
+    m_model->removeRows(0, 15);
+    range = view->blockRange(QStringLiteral("Category 3"));
+    QCOMPARE(range.firstRow, 15);
+    QCOMPARE(range.count, 10);
+    QCOMPARE(range.ordinal, 2);
+    QCOMPARE(view->block(QStringLiteral("Category 3")).count(), range.count);
+    QCOMPARE(view->block(QStringLiteral("Category 3")).constFirst().row(), range.firstRow);
+    QCOMPARE(view->blockCount(), 5);
+}
+
+void KCategorizedViewTest::testCategoryChangeMovesRow_data()
+{
+    QTest::addColumn<int>("sourceRow");
+    QTest::addColumn<int>("category");
+
+    QTest::newRow("down") << 5 << 4;
+    QTest::newRow("up") << 52 << 1;
+    QTest::newRow("new category") << 15 << 9;
+    QTest::newRow("last row of its category") << 29 << 0;
+}
+
+void KCategorizedViewTest::testCategoryChangeMovesRow()
+{
+    QFETCH(int, sourceRow);
+    QFETCH(int, category);
+
+    KCategorizedView *view = createView();
+    view->visualRect(m_proxyModel->index(m_proxyModel->rowCount() - 1, 0));
+
+    KItemViewsInstrumentation::setEnabled(true);
+    KItemViewsInstrumentation::resetCounters();
+    QSignalSpy layoutChangedSpy(m_proxyModel, &QAbstractItemModel::layoutChanged);
+    m_model->setItemData(m_model->index(sourceRow, 0),
+                         {{KCategorizedSortFilterProxyModel::CategoryDisplayRole, QStringLiteral("Category %1").arg(category)},
+                          {KCategorizedSortFilterProxyModel::CategorySortRole, category}});
+    QCOMPARE(layoutChangedSpy.count(), 1);
+    // the blocks were not all laid out again
+    QCOMPARE(KItemViewsInstrumentation::counter(KItemViewsInstrumentation::LayoutSweeps), qint64(0));
+    KItemViewsInstrumentation::setEnabled(false);
+
+    const QModelIndex movedIndex = m_proxyModel->mapFromSource(m_model->index(sourceRow, 0));
+    QCOMPARE(view->blockRange(movedIndex).firstRow, view->blockRange(QStringLiteral("Category %1").arg(category)).firstRow);
+    compareWithFreshView(view);
+}
+
+void KCategorizedViewTest::testLayoutStateRoundTrip()
+{
+    KCategorizedView *view = createView();
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+    const QByteArray state = view->saveLayoutState("fingerprint");
+    QVERIFY(!state.isEmpty());
+
+    // restored before the model is set
+    auto *restoredView = new KCategorizedView;
+    m_views << restoredView;
+    restoredView->setCategoryDrawer(new KCategoryDrawer(restoredView));
+    restoredView->setViewMode(QListView::IconMode);
+    restoredView->resize(view->size());
+    QVERIFY(restoredView->restoreLayoutState(state, "fingerprint"));
+    restoredView->setModel(m_proxyModel);
+    restoredView->show();
+    QVERIFY(QTest::qWaitForWindowExposed(restoredView));
+    compareWithFreshView(restoredView);
+    QCOMPARE(restoredView->saveLayoutState("fingerprint"), state);
+
+    // and after
+    KCategorizedView *otherView = createView();
+    otherView->show();
+    QVERIFY(QTest::qWaitForWindowExposed(otherView));
+    QVERIFY(otherView->restoreLayoutState(state, "fingerprint"));
+    compareWithFreshView(otherView);
+}
+
+void KCategorizedViewTest::testLayoutStateRejected_data()
+{
+    QTest::addColumn<int>("corruptedByte");
+    QTest::addColumn<int>("truncatedSize");
+    QTest::addColumn<QByteArray>("fingerprint");
+
+    // the state starts with a 4 bytes magic number and a 1 byte version
+    QTest::newRow("wrong magic") << 0 << -1 << QByteArray("fingerprint");
+    QTest::newRow("wrong version") << 4 << -1 << QByteArray("fingerprint");
+    QTest::newRow("fingerprint mismatch") << -1 << -1 << QByteArray("other fingerprint");
+    QTest::newRow("truncated header") << -1 << 20 << QByteArray("fingerprint");
+    QTest::newRow("truncated items") << -1 << 200 << QByteArray("fingerprint");
+    QTest::newRow("empty") << -1 << 0 << QByteArray("fingerprint");
+}
+
+void KCategorizedViewTest::testLayoutStateRejected()
+{
+    QFETCH(int, corruptedByte);
+    QFETCH(int, truncatedSize);
+    QFETCH(QByteArray, fingerprint);
+
+    KCategorizedView *view = createView();
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+    QByteArray state = view->saveLayoutState("fingerprint");
+    if (corruptedByte != -1) {
+        state[corruptedByte] = char(state.at(corruptedByte) ^ 0x5a);
+    }
+    if (truncatedSize != -1) {
+        QVERIFY(truncatedSize < state.size());
+        state.truncate(truncatedSize);
+    }
+
+    // a different layout, which a rejected state must not replace
+    view->resize(view->width() + 50, view->height());
+    QList<QRect> rects;
+    for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+        rects << view->visualRect(m_proxyModel->index(row, 0));
+    }
+
+    QVERIFY(!view->restoreLayoutState(state, fingerprint));
+    for (int row = 0; row < m_proxyModel->rowCount(); ++row) {
+        QCOMPARE(view->visualRect(m_proxyModel->index(row, 0)), rects.at(row));
+    }
+    compareWithFreshView(view);
+}
+
+void KCategorizedViewTest::testLayoutStateRowCountChanged()
+{
+    KCategorizedView *view = createView();
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view));
+    const QByteArray state = view->saveLayoutState("fingerprint");
+
+    // the caller did not change the fingerprint, the row count gives it away
+    m_model->removeRow(0);
+    QVERIFY(view->restoreLayoutState(state, "fingerprint"));
+    compareWithFreshView(view);
+
+    KCategorizedView *otherView = createView();
+    QVERIFY(otherView->restoreLayoutState(state, "fingerprint"));
+    otherView->show();
+    QVERIFY(QTest::qWaitForWindowExposed(otherView));
+    compareWithFreshView(otherView);
+}
+
+void KCategorizedViewTest::testLargeVariableSizeBlock()
+{
+    // enough items in a single block to overflow the stack if they were placed recursively
+    QStandardItemModel model;
+    for (int i = 0; i < 100000; ++i) {
+        auto *item = new QStandardItem(QString::number(i));
+        item->setData(QStringLiteral("Category"), KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+        item->setData(0, KCategorizedSortFilterProxyModel::CategorySortRole);
+        model.appendRow(item);
+    }
+    KCategorizedSortFilterProxyModel proxyModel;
+    proxyModel.setCategorizedModel(true);
+    proxyModel.setSourceModel(&model);
+
+    KCategorizedView view;
+    view.setCategoryDrawer(new KCategoryDrawer(&view));
+    view.setViewMode(QListView::IconMode);
+    view.resize(300, 400);
+    view.setModel(&proxyModel);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+
+    const QModelIndex last = proxyModel.index(proxyModel.rowCount() - 1, 0);
+    const QRect lastRect = view.visualRect(last);
+    QVERIFY(lastRect.isValid());
+    // a narrower viewport fits less items per row
+    view.resize(200, 400);
+    QTRY_VERIFY(view.visualRect(last).bottom() > lastRect.bottom());
+}
+
+QTEST_MAIN(KCategorizedViewTest)
+
+#include "kcategorizedviewtest.moc"
@@ -0,0 +1,190 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <QListView>
+#include <QPushButton>
+#include <QStandardItemModel>
+#include <QTreeView>
+
+#include <kwidgetitemdelegate.h>
+
+class ButtonDelegate : public KWidgetItemDelegate
+{
+public:
+    using KWidgetItemDelegate::KWidgetItemDelegate;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        Q_UNUSED(painter)
+        Q_UNUSED(option)
+        Q_UNUSED(index)
+    }
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        Q_UNUSED(option)
+        Q_UNUSED(index)
+        return QSize(100, 20);
+    }
+
+    mutable int createdWidgets = 0;
+    mutable int updatedWidgets = 0;
+
+protected:
+    QList<QWidget *> createItemWidgets(const QModelIndex &index) const override
+    {
+        Q_UNUSED(index)
+        ++createdWidgets;
+        return {new QPushButton};
+    }
+
+    void updateItemWidgets(const QList<QWidget *> &widgets, const QStyleOptionViewItem &option, const QPersistentModelIndex &index) const override
+    {
+        Q_UNUSED(option)
+        ++updatedWidgets;
+        auto *button = static_cast<QPushButton *>(widgets.constFirst());
+        button->setText(index.data().toString());
+        button->setGeometry(0, 0, 100, 20);
+    }
+};
+
+class KWidgetItemDelegateTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testVisibleWidgetsOnly_data();
+    void testVisibleWidgetsOnly();
+    void testCoalescedUpdates();
+    void testTreeView();
+};
+
+void KWidgetItemDelegateTest::testVisibleWidgetsOnly_data()
+{
+    QTest::addColumn<bool>("recycling");
+
+    QTest::newRow("kept") << false;
+    QTest::newRow("recycled") << true;
+}
+
+void KWidgetItemDelegateTest::testVisibleWidgetsOnly()
+{
+    QFETCH(bool, recycling);
+
+    QStandardItemModel model;
+    for (int i = 0; i < 2000; ++i) {
+        model.appendRow(new QStandardItem(QStringLiteral("row %1").arg(i)));
+    }
+
+    QListView view;
+    view.setUniformItemSizes(true);
+    auto *delegate = new ButtonDelegate(&view, &view);
+    delegate->setWidgetRecyclingEnabled(recycling);
+    view.setItemDelegate(delegate);
+    view.setModel(&model);
+    view.resize(200, 200);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+
+    // only the rows in the viewport and its margin get widgets
+    QTRY_VERIFY(delegate->createdWidgets > 0);
+    const int initialWidgets = delegate->createdWidgets;
+    QVERIFY(initialWidgets < 50);
+
+    view.scrollToBottom();
+    const QModelIndex last = model.index(model.rowCount() - 1, 0);
+    const auto buttonOfLastRow = [&view, &last]() {
+        return qobject_cast<QPushButton *>(view.viewport()->childAt(view.visualRect(last).topLeft() + QPoint(1, 1)));
+    };
+    QTRY_VERIFY(buttonOfLastRow());
+    QCOMPARE(buttonOfLastRow()->text(), QStringLiteral("row 1999"));
+
+    if (recycling) {
+        // the rows scrolled in took the widgets of the rows scrolled out
+        QVERIFY(delegate->createdWidgets <= initialWidgets + initialWidgets / 2);
+    } else {
+        QVERIFY(delegate->createdWidgets > initialWidgets + initialWidgets / 2);
+    }
+    QVERIFY(delegate->createdWidgets < 100);
+}
+
+void KWidgetItemDelegateTest::testCoalescedUpdates()
+{
+    QStandardItemModel model;
+    for (int i = 0; i < 200; ++i) {
+        model.appendRow(new QStandardItem(QStringLiteral("row %1").arg(i)));
+    }
+
+    QListView view;
+    view.setUniformItemSizes(true);
+    auto *delegate = new ButtonDelegate(&view, &view);
+    view.setItemDelegate(delegate);
+    view.setModel(&model);
+    view.resize(200, 200);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    QTRY_VERIFY(delegate->updatedWidgets > 0);
+    QTest::qWait(50);
+
+    // the cost of a single pass
+    delegate->updatedWidgets = 0;
+    view.resize(210, 200);
+    QTRY_VERIFY(delegate->updatedWidgets > 0);
+    QTest::qWait(50);
+    const int singlePass = delegate->updatedWidgets;
+
+    // a burst of changes within one event loop iteration is handled by a single pass as well
+    delegate->updatedWidgets = 0;
+    for (int i = 0; i < 20; ++i) {
+        view.resize(200 + i, 200);
+        model.insertRow(0, new QStandardItem(QStringLiteral("new row %1").arg(i)));
+    }
+    QCOMPARE(delegate->updatedWidgets, 0);
+    QTRY_VERIFY(delegate->updatedWidgets > 0);
+    QTest::qWait(50);
+    // the view may lay itself out once more afterwards, resizing the viewport
+    QVERIFY(delegate->updatedWidgets <= 2 * singlePass);
+}
+
+void KWidgetItemDelegateTest::testTreeView()
+{
+    QStandardItemModel model;
+    for (int i = 0; i < 200; ++i) {
+        auto *item = new QStandardItem(QStringLiteral("row %1").arg(i));
+        for (int j = 0; j < 10; ++j) {
+            item->appendRow(new QStandardItem(QStringLiteral("row %1.%2").arg(i).arg(j)));
+        }
+        model.appendRow(item);
+    }
+
+    QTreeView view;
+    auto *delegate = new ButtonDelegate(&view, &view);
+    view.setItemDelegate(delegate);
+    view.setModel(&model);
+    view.resize(200, 200);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    QTRY_VERIFY(delegate->createdWidgets > 0);
+    QVERIFY(delegate->createdWidgets < 50);
+
+    // the children of an expanded item far down the tree get widgets once scrolled to
+    const QModelIndex parent = model.index(150, 0);
+    view.expand(parent);
+    const QModelIndex child = model.index(5, 0, parent);
+    view.scrollTo(child);
+    const auto buttonOfChild = [&view, &child]() {
+        return qobject_cast<QPushButton *>(view.viewport()->childAt(view.visualRect(child).topLeft() + QPoint(1, 1)));
+    };
+    QTRY_VERIFY(buttonOfChild());
+    QCOMPARE(buttonOfChild()->text(), QStringLiteral("row 150.5"));
+    QVERIFY(delegate->createdWidgets < 100);
+}
+
+QTEST_MAIN(KWidgetItemDelegateTest)
+
+#include "kwidgetitemdelegatetest.moc"
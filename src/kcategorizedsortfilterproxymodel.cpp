@@ -10,22 +10,1214 @@
 #include "kcategorizedsortfilterproxymodel_p.h"
 
 #include <QCollator>
+#include <QHash>
+#include <QMetaMethod>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+// gives every key the position of its value among the distinct values sorted by compare, values
+// comparing equal sharing their position, and fills ranks with the position of every distinct value
+template<typename Compare>
+static QList<int> rankStrings(const QList<QString> &keys, Compare compare, QHash<QString, int> &ranks)
+{
+    ranks.clear();
+    for (const QString &key : keys) {
+        ranks.insert(key, 0);
+    }
+    QStringList distinctKeys = ranks.keys();
+    std::sort(distinctKeys.begin(), distinctKeys.end(), [&compare](const QString &left, const QString &right) {
+        return compare(left, right) < 0;
+    });
+
+    int rank = 0;
+    for (int i = 0; i < distinctKeys.count(); ++i) {
+        if (i > 0 && compare(distinctKeys.at(i - 1), distinctKeys.at(i)) != 0) {
+            ++rank;
+        }
+        ranks[distinctKeys.at(i)] = rank;
+    }
+
+    QList<int> result(keys.count());
+    for (int i = 0; i < keys.count(); ++i) {
+        result[i] = ranks.value(keys.at(i));
+    }
+    return result;
+}
+
+static double aggregateIdentity(KCategorizedSortFilterProxyModel::AggregateFunction function)
+{
+    switch (function) {
+    case KCategorizedSortFilterProxyModel::MinimumAggregate:
+        return std::numeric_limits<double>::infinity();
+    case KCategorizedSortFilterProxyModel::MaximumAggregate:
+        return -std::numeric_limits<double>::infinity();
+    case KCategorizedSortFilterProxyModel::SumAggregate:
+        break;
+    }
+    return 0;
+}
+
+static double combineAggregate(KCategorizedSortFilterProxyModel::AggregateFunction function, double aggregate, double value)
+{
+    switch (function) {
+    case KCategorizedSortFilterProxyModel::MinimumAggregate:
+        return qMin(aggregate, value);
+    case KCategorizedSortFilterProxyModel::MaximumAggregate:
+        return qMax(aggregate, value);
+    case KCategorizedSortFilterProxyModel::SumAggregate:
+        break;
+    }
+    return aggregate + value;
+}
+
+// BEGIN: parallel sort
+
+// a top level source row, with its keys mapped to unsigned integers of the same order
+struct SortEntry {
+    quint64 category;
+    quint64 subKey;
+    int row;
+};
+
+// chunks smaller than this are not worth a thread
+static const qsizetype s_minimumChunkSize = 16384;
+// above this many distinct category keys, rows are not bucketed by category first
+static const int s_maximumBucketedCategories = 65536;
+
+static quint64 orderedKey(qlonglong value)
+{
+    return quint64(value) ^ (quint64(1) << 63);
+}
+
+static quint64 orderedKey(double value)
+{
+    const quint64 bits = std::bit_cast<quint64>(value);
+    return (bits & (quint64(1) << 63)) ? ~bits : bits | (quint64(1) << 63);
+}
+
+// runs all tasks on the global thread pool, and the calling thread, and returns once they are done
+static void runConcurrently(const std::vector<std::function<void()>> &tasks)
+{
+    if (tasks.empty()) {
+        return;
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    QSemaphore done;
+    std::vector<std::unique_ptr<QRunnable>> runnables;
+    for (size_t i = 1; i < tasks.size(); ++i) {
+        runnables.emplace_back(QRunnable::create([&tasks, &done, i]() {
+            tasks[i]();
+            done.release();
+        }));
+        runnables.back()->setAutoDelete(false);
+        pool->start(runnables.back().get());
+    }
+    tasks.front()();
+    // the tasks no thread picked yet run here, so a busy pool cannot make this wait forever
+    for (const std::unique_ptr<QRunnable> &runnable : runnables) {
+        if (pool->tryTake(runnable.get())) {
+            runnable->run();
+        }
+    }
+    done.acquire(int(runnables.size()));
+}
+
+// sorts chunks of [begin, end) on separate threads, and merges them pairwise
+template<typename Less>
+static void parallelSort(SortEntry *begin, SortEntry *end, Less less)
+{
+    const qsizetype count = end - begin;
+    const qsizetype chunkCount = qBound<qsizetype>(1, count / s_minimumChunkSize, qMax(QThreadPool::globalInstance()->maxThreadCount(), 1));
+    if (chunkCount == 1) {
+        std::sort(begin, end, less);
+        return;
+    }
+
+    std::vector<SortEntry *> bounds(chunkCount + 1);
+    for (qsizetype i = 0; i <= chunkCount; ++i) {
+        bounds[i] = begin + count * i / chunkCount;
+    }
+
+    std::vector<std::function<void()>> tasks;
+    for (qsizetype i = 0; i < chunkCount; ++i) {
+        tasks.push_back([&bounds, &less, i]() {
+            std::sort(bounds[i], bounds[i + 1], less);
+        });
+    }
+    runConcurrently(tasks);
+
+    for (qsizetype width = 1; width < chunkCount; width *= 2) {
+        tasks.clear();
+        for (qsizetype i = 0; i + width < chunkCount; i += 2 * width) {
+            tasks.push_back([&bounds, &less, i, width, chunkCount]() {
+                std::inplace_merge(bounds[i], bounds[i + width], bounds[qMin(i + 2 * width, chunkCount)], less);
+            });
+        }
+        runConcurrently(tasks);
+    }
+}
+
+// sorts the entries by category and then sub-sort key. If categoryCount is positive the categories
+// are ranks below it, and a counting pass puts every row in the bucket of its category first.
+static void sortEntries(std::vector<SortEntry> &entries, int categoryCount)
+{
+    if (categoryCount <= 0) {
+        parallelSort(entries.data(), entries.data() + entries.size(), [](const SortEntry &left, const SortEntry &right) {
+            return left.category != right.category ? left.category < right.category : left.subKey < right.subKey;
+        });
+        return;
+    }
+
+    std::vector<qsizetype> offsets(categoryCount + 1, 0);
+    for (const SortEntry &entry : entries) {
+        ++offsets[entry.category + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<SortEntry> bucketed(entries.size());
+    std::vector<qsizetype> next(offsets.begin(), offsets.end() - 1);
+    for (const SortEntry &entry : entries) {
+        bucketed[next[entry.category]++] = entry;
+    }
+    entries.swap(bucketed);
+
+    // buckets bigger than a chunk are sorted in parallel themselves, smaller ones are sorted
+    // together on a thread until they add up to a chunk
+    const auto bySubKey = [](const SortEntry &left, const SortEntry &right) {
+        return left.subKey < right.subKey;
+    };
+    SortEntry *const data = entries.data();
+    std::vector<std::function<void()>> tasks;
+    std::vector<int> largeBuckets;
+    const auto addGroup = [&](int firstCategory, int lastCategory) {
+        if (lastCategory > firstCategory) {
+            tasks.push_back([data, &offsets, &bySubKey, firstCategory, lastCategory]() {
+                for (int category = firstCategory; category < lastCategory; ++category) {
+                    std::sort(data + offsets[category], data + offsets[category + 1], bySubKey);
+                }
+            });
+        }
+    };
+    int groupFirstCategory = 0;
+    for (int category = 0; category < categoryCount; ++category) {
+        if (offsets[category + 1] - offsets[category] > s_minimumChunkSize) {
+            addGroup(groupFirstCategory, category);
+            largeBuckets.push_back(category);
+            groupFirstCategory = category + 1;
+        } else if (offsets[category + 1] - offsets[groupFirstCategory] >= s_minimumChunkSize) {
+            addGroup(groupFirstCategory, category + 1);
+            groupFirstCategory = category + 1;
+        }
+    }
+    addGroup(groupFirstCategory, categoryCount);
+    runConcurrently(tasks);
+
+    for (int category : largeBuckets) {
+        parallelSort(data + offsets[category], data + offsets[category + 1], bySubKey);
+    }
+}
+
+// END: parallel sort
+
+const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &KCategorizedSortFilterProxyModelPrivate::categoryRuns()
+{
+    if (!runsValid) {
+        runs.clear();
+        keyedRuns = usesCategoryKeys();
+        const int rowCount = q->rowCount();
+        for (int row = 0; row < rowCount; ++row) {
+            appendToRuns(runs, rowCategory(row));
+        }
+        runsValid = true;
+    }
+    return runs;
+}
+
+bool KCategorizedSortFilterProxyModelPrivate::sameCategory(const CategoryRun &left, const CategoryRun &right) const
+{
+    return keyedRuns ? left.key == right.key : left.category == right.category;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::appendToRuns(QList<CategoryRun> &list, const CategoryRun &row) const
+{
+    if (!list.isEmpty() && sameCategory(list.last(), row)) {
+        mergeRuns(list.last(), row);
+    } else {
+        list.append(row);
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::mergeRuns(CategoryRun &into, const CategoryRun &run) const
+{
+    into.count += run.count;
+    if (!into.aggregatesValid || !run.aggregatesValid) {
+        into.aggregatesValid = false;
+        return;
+    }
+    for (int i = 0; i < into.aggregates.count(); ++i) {
+        into.aggregates[i] = combineAggregate(aggregates.at(i).function, into.aggregates.at(i), run.aggregates.at(i));
+    }
+}
+
+int KCategorizedSortFilterProxyModelPrivate::runForRow(int row)
+{
+    const QList<CategoryRun> &allRuns = categoryRuns();
+    auto it = std::upper_bound(allRuns.cbegin(), allRuns.cend(), row, [](int value, const CategoryRun &run) {
+        return value < run.firstRow;
+    });
+    if (it == allRuns.cbegin()) {
+        return -1;
+    }
+    --it;
+    if (row >= it->firstRow + it->count) {
+        return -1;
+    }
+    return it - allRuns.cbegin();
+}
+
+QString KCategorizedSortFilterProxyModelPrivate::categoryForRow(int row)
+{
+    const int run = runForRow(row);
+    return run == -1 ? QString() : runs[run].category;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::invalidateCategoryRuns()
+{
+    runsValid = false;
+    runs.clear();
+}
+
+void KCategorizedSortFilterProxyModelPrivate::notifyCategoriesChanged(int firstRow, int lastRow)
+{
+    if (!q->isSignalConnected(QMetaMethod::fromSignal(&KCategorizedSortFilterProxyModel::categoriesChanged))) {
+        return;
+    }
+
+    const int rowCount = q->rowCount();
+    if (!rowCount) {
+        Q_EMIT q->categoriesChanged(0, -1);
+        return;
+    }
+    Q_EMIT q->categoriesChanged(runForRow(qBound(0, firstRow, rowCount - 1)), runForRow(qBound(0, lastRow, rowCount - 1)));
+}
+
+void KCategorizedSortFilterProxyModelPrivate::notifyAllCategoriesChanged()
+{
+    if (q->isSignalConnected(QMetaMethod::fromSignal(&KCategorizedSortFilterProxyModel::categoriesChanged))) {
+        Q_EMIT q->categoriesChanged(0, categoryRuns().count() - 1);
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::rowsInserted(const QModelIndex &parent, int start, int end)
+{
+    if (!runsValid || parent.isValid()) {
+        return;
+    }
+    if (runs.isEmpty()) {
+        // the first rows, which tell whether the runs are keyed
+        invalidateCategoryRuns();
+        return;
+    }
+
+    const int count = end - start + 1;
+    QList<CategoryRun> inserted;
+    for (int row = start; row <= end; ++row) {
+        appendToRuns(inserted, rowCategory(row));
+    }
+
+    // first run starting at or after the insertion point
+    int pos = std::lower_bound(runs.cbegin(),
+                               runs.cend(),
+                               start,
+                               [](const CategoryRun &run, int value) {
+                                   return run.firstRow < value;
+                               })
+        - runs.cbegin();
+
+    if (pos > 0) {
+        CategoryRun &previous = runs[pos - 1];
+        const int previousEnd = previous.firstRow + previous.count;
+        // rows inserted in the middle of a run of their own category, as sorting puts them,
+        // only grow it, and its aggregates take their values in
+        if (previousEnd > start && inserted.count() == 1 && sameCategory(previous, inserted.constFirst())) {
+            mergeRuns(previous, inserted.constFirst());
+            for (int i = pos; i < runs.count(); ++i) {
+                runs[i].firstRow += count;
+            }
+            return;
+        }
+
+        // rows of other categories split it in two
+        if (previousEnd > start) {
+            // the aggregates of both halves are computed again when asked
+            const CategoryRun tail{previous.category, start, previousEnd - start, previous.key, previous.aggregates, false};
+            previous.count = start - previous.firstRow;
+            previous.aggregatesValid = false;
+            runs.insert(pos, tail);
+        }
+    }
+
+    for (int i = pos; i < runs.count(); ++i) {
+        runs[i].firstRow += count;
+    }
+    runs = runs.mid(0, pos) + inserted + runs.mid(pos);
+
+    // merge the inserted runs with their neighbours if they share the category
+    const auto mergeWithPrevious = [this](int i) {
+        if (i > 0 && i < runs.count() && sameCategory(runs[i - 1], runs[i])) {
+            mergeRuns(runs[i - 1], runs[i]);
+            runs.removeAt(i);
+        }
+    };
+    mergeWithPrevious(pos + inserted.count());
+    mergeWithPrevious(pos);
+}
+
+void KCategorizedSortFilterProxyModelPrivate::rowsRemoved(const QModelIndex &parent, int start, int end)
+{
+    if (!runsValid || parent.isValid()) {
+        return;
+    }
+
+    const int count = end - start + 1;
+    QList<CategoryRun> remaining;
+    remaining.reserve(runs.count());
+    for (CategoryRun run : std::as_const(runs)) {
+        const int removedFromRun = qMax(0, qMin(run.firstRow + run.count, end + 1) - qMax(run.firstRow, start));
+        run.count -= removedFromRun;
+        if (run.firstRow > end) {
+            run.firstRow -= count;
+        } else if (run.firstRow >= start) {
+            run.firstRow = start;
+        }
+        if (!run.count) {
+            continue;
+        }
+        appendToRuns(remaining, run);
+    }
+    runs = remaining;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+{
+    if (!runsValid || topLeft.parent().isValid()) {
+        return;
+    }
+
+    if (keyedRuns) {
+        // the display strings are shared by key, any row may have changed that of its category
+        if (roles.contains(KCategorizedSortFilterProxyModel::CategoryDisplayRole)) {
+            categoryDisplays.clear();
+            invalidateCategoryRuns();
+            return;
+        }
+    } else {
+        if (!roles.isEmpty() && !roles.contains(KCategorizedSortFilterProxyModel::CategoryDisplayRole)) {
+            return;
+        }
+
+        if (sortColumn < topLeft.column() || sortColumn > bottomRight.column()) {
+            return;
+        }
+    }
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const int run = runForRow(row);
+        if (run == -1 || !sameCategory(runs[run], rowCategory(row))) {
+            // a row changed its category, usually followed by sorting again
+            invalidateCategoryRuns();
+            return;
+        }
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::ensureSortKeys(int column)
+{
+    if (sortKeysValid && sortKeysColumn == column) {
+        return;
+    }
+
+    invalidateSortKeys();
+    sortKeysColumn = column;
+    sortKeysValid = true;
+    const QAbstractItemModel *sourceModel = q->sourceModel();
+    const int rowCount = sourceModel ? sourceModel->rowCount() : 0;
+    if (!rowCount) {
+        // the type is only known once there are rows
+        return;
+    }
+
+    if (usesCategoryKeys()) {
+        sortKeyType = CategoryKeySortKeys;
+        categoryKeys.resize(rowCount);
+        fetchSortKeys(0, rowCount - 1);
+        return;
+    }
+
+    const QVariant first = sourceModel->index(0, column).data(KCategorizedSortFilterProxyModel::CategorySortRole);
+    if (first.userType() == QMetaType::QString) {
+        sortKeyType = StringSortKeys;
+        stringSortKeys.resize(rowCount);
+    } else {
+        sortKeyType = NumberSortKeys;
+        numberSortKeys.resize(rowCount);
+    }
+    fetchSortKeys(0, rowCount - 1);
+}
+
+void KCategorizedSortFilterProxyModelPrivate::invalidateSortKeys()
+{
+    sortKeysValid = false;
+    sortKeyType = NoSortKeys;
+    numberSortKeys.clear();
+    stringSortKeys.clear();
+    categoryKeys.clear();
+    stringSortRanks.clear();
+    stringKeyRanks.clear();
+    sortRanksValid = false;
+    unrankedStringKeys = false;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::ensureSortRanks()
+{
+    if (sortKeyType != StringSortKeys) {
+        return;
+    }
+    // dynamic sorting does not go through sort(), which checks the locale too
+    if (sortCategoriesByNaturalComparison) {
+        updateCollatorLocale();
+    }
+    if (sortRanksValid) {
+        return;
+    }
+
+    stringSortRanks = rankStrings(
+        stringSortKeys,
+        [this](const QString &left, const QString &right) {
+            return compareStrings(left, right);
+        },
+        stringKeyRanks);
+    sortRanksValid = true;
+    unrankedStringKeys = false;
+}
+
+int KCategorizedSortFilterProxyModelPrivate::compareStrings(const QString &left, const QString &right) const
+{
+    if (sortCategoriesByNaturalComparison) {
+        return m_collator.compare(left, right);
+    }
+    const int compare = QString::compare(left, right);
+    return compare < 0 ? -1 : (compare > 0 ? 1 : 0);
+}
+
+bool KCategorizedSortFilterProxyModelPrivate::updateCollatorLocale()
+{
+    const QLocale locale;
+    if (m_collator.locale() == locale) {
+        return false;
+    }
+
+    m_collator.setLocale(locale);
+    sortRanksValid = false;
+    return true;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::fetchSortKeys(int start, int end)
+{
+    if (sortKeyType == CategoryKeySortKeys) {
+        for (int row = start; row <= end; ++row) {
+            categoryKeys[row] = q->categoryKey(row);
+        }
+        return;
+    }
+
+    const QAbstractItemModel *sourceModel = q->sourceModel();
+    for (int row = start; row <= end; ++row) {
+        const QVariant key = sourceModel->index(row, sortKeysColumn).data(KCategorizedSortFilterProxyModel::CategorySortRole);
+        if (sortKeyType == StringSortKeys) {
+            stringSortKeys[row] = key.toString();
+            // a key seen when ranking keeps its rank, any other is compared with the collator
+            // until the next full sort ranks the keys again
+            if (sortRanksValid) {
+                const int rank = stringKeyRanks.value(stringSortKeys.at(row), -1);
+                stringSortRanks[row] = rank;
+                unrankedStringKeys |= rank == -1;
+            }
+        } else {
+            numberSortKeys[row] = key.toLongLong();
+        }
+    }
+}
+
+int KCategorizedSortFilterProxyModelPrivate::compareSortKeys(int left, int right) const
+{
+    if (sortKeyType == StringSortKeys) {
+        const int lrank = stringSortRanks.at(left);
+        const int rrank = stringSortRanks.at(right);
+        if (lrank == -1 || rrank == -1) {
+            return compareStrings(stringSortKeys.at(left), stringSortKeys.at(right));
+        }
+        return lrank < rrank ? -1 : (rrank < lrank ? 1 : 0);
+    }
+
+    if (sortKeyType == CategoryKeySortKeys) {
+        const quint64 lkey = categoryKeys.at(left);
+        const quint64 rkey = categoryKeys.at(right);
+        return lkey < rkey ? -1 : (rkey < lkey ? 1 : 0);
+    }
+
+    const qlonglong lint = numberSortKeys.at(left);
+    const qlonglong rint = numberSortKeys.at(right);
+    return lint < rint ? -1 : (rint < lint ? 1 : 0);
+}
+
+void KCategorizedSortFilterProxyModelPrivate::computeSortPositions(int column)
+{
+    sortPositions.clear();
+    const QAbstractItemModel *sourceModel = q->sourceModel();
+    const int rowCount = sourceModel ? sourceModel->rowCount() : 0;
+    if (rowCount < 2 || column < 0 || column >= sourceModel->columnCount()) {
+        return;
+    }
+
+    std::vector<SortEntry> entries(rowCount);
+    for (int row = 0; row < rowCount; ++row) {
+        entries[row].row = row;
+    }
+
+    // BEGIN: category keys
+    int categoryCount = 1;
+    if (categorizedModel) {
+        ensureSortKeys(column);
+        ensureSortRanks();
+        if (sortKeyType == StringSortKeys) {
+            categoryCount = 0;
+            for (int row = 0; row < rowCount; ++row) {
+                entries[row].category = stringSortRanks.at(row);
+                categoryCount = qMax(categoryCount, stringSortRanks.at(row) + 1);
+            }
+        } else if (sortKeyType == NumberSortKeys || sortKeyType == CategoryKeySortKeys) {
+            const auto key = [this](int row) {
+                return sortKeyType == CategoryKeySortKeys ? categoryKeys.at(row) : orderedKey(numberSortKeys.at(row));
+            };
+            // ranked too, when there are few enough of them to bucket rows by category
+            QHash<quint64, int> ranks;
+            for (int row = 0; row < rowCount && ranks.count() <= s_maximumBucketedCategories; ++row) {
+                ranks.insert(key(row), 0);
+            }
+            if (ranks.count() <= s_maximumBucketedCategories) {
+                QList<quint64> distinctKeys = ranks.keys();
+                std::sort(distinctKeys.begin(), distinctKeys.end());
+                for (int i = 0; i < distinctKeys.count(); ++i) {
+                    ranks[distinctKeys.at(i)] = i;
+                }
+                categoryCount = distinctKeys.count();
+                for (int row = 0; row < rowCount; ++row) {
+                    entries[row].category = ranks.value(key(row));
+                }
+            } else {
+                categoryCount = 0;
+                for (int row = 0; row < rowCount; ++row) {
+                    entries[row].category = key(row);
+                }
+            }
+        } else {
+            return;
+        }
+    } else {
+        for (SortEntry &entry : entries) {
+            entry.category = 0;
+        }
+    }
+    // END: category keys
+
+    // BEGIN: sub-sort keys
+    const auto subSortKey = [this, sourceModel, column](int row) {
+        const QModelIndex index = sourceModel->index(row, column);
+        return subSortKeyExtractor ? subSortKeyExtractor(index) : index.data(q->sortRole());
+    };
+    const QVariant first = subSortKey(0);
+    const int type = first.userType();
+    switch (type) {
+    case QMetaType::QString: {
+        QList<QString> keys(rowCount);
+        for (int row = 0; row < rowCount; ++row) {
+            const QVariant key = row ? subSortKey(row) : first;
+            if (key.userType() != type) {
+                return;
+            }
+            keys[row] = key.toString();
+        }
+        // the way QSortFilterProxyModel::lessThan() compares strings
+        QList<int> ranks;
+        if (q->isSortLocaleAware()) {
+            ranks = rankStrings(keys, [](const QString &left, const QString &right) {
+                return QString::localeAwareCompare(left, right);
+            });
+        } else {
+            const Qt::CaseSensitivity caseSensitivity = q->sortCaseSensitivity();
+            ranks = rankStrings(keys, [caseSensitivity](const QString &left, const QString &right) {
+                return QString::compare(left, right, caseSensitivity);
+            });
+        }
+        for (int row = 0; row < rowCount; ++row) {
+            entries[row].subKey = ranks.at(row);
+        }
+        break;
+    }
+    case QMetaType::Bool:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::Short:
+    case QMetaType::Int:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::UChar:
+    case QMetaType::UShort:
+    case QMetaType::UInt:
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+    case QMetaType::Float:
+    case QMetaType::Double: {
+        const bool isSigned = type != QMetaType::UChar && type != QMetaType::UShort && type != QMetaType::UInt && type != QMetaType::ULong
+            && type != QMetaType::ULongLong;
+        const bool isFloatingPoint = type == QMetaType::Float || type == QMetaType::Double;
+        for (int row = 0; row < rowCount; ++row) {
+            const QVariant key = row ? subSortKey(row) : first;
+            if (key.userType() != type) {
+                return;
+            }
+            if (isFloatingPoint) {
+                entries[row].subKey = orderedKey(key.toDouble());
+            } else if (isSigned) {
+                entries[row].subKey = orderedKey(key.toLongLong());
+            } else {
+                entries[row].subKey = key.toULongLong();
+            }
+        }
+        break;
+    }
+    default:
+        // left to QSortFilterProxyModel::lessThan()
+        return;
+    }
+    // END: sub-sort keys
+
+    sortEntries(entries, categoryCount);
+
+    sortPositions.resize(rowCount);
+    int position = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i > 0 && (entries[i].category != entries[i - 1].category || entries[i].subKey != entries[i - 1].subKey)) {
+            ++position;
+        }
+        sortPositions[entries[i].row] = position;
+    }
+}
+
+bool KCategorizedSortFilterProxyModelPrivate::categoryFilterAccepts(int sourceRow)
+{
+    // the keys of the sort column, which are the ones sorting asks for too
+    ensureSortKeys(qMax(sortColumn, 0));
+    bool listed = false;
+    switch (sortKeyType) {
+    case NumberSortKeys:
+        listed = listedNumberKeys.contains(quint64(numberSortKeys.at(sourceRow)));
+        break;
+    case StringSortKeys:
+        listed = listedStringKeys.contains(stringSortKeys.at(sourceRow));
+        break;
+    case CategoryKeySortKeys:
+        listed = listedNumberKeys.contains(categoryKeys.at(sourceRow));
+        break;
+    case NoSortKeys:
+        return true;
+    }
+    return listed == (categoryFilter == AcceptListedCategories);
+}
+
+bool KCategorizedSortFilterProxyModelPrivate::isCategoryListed(const QVariant &key) const
+{
+    if (key.userType() == QMetaType::QString) {
+        return listedStringKeys.contains(key.toString());
+    }
+    return listedNumberKeys.contains(key.toULongLong());
+}
+
+void KCategorizedSortFilterProxyModelPrivate::setCategoryListed(const QVariant &key, bool listed)
+{
+    if (key.userType() == QMetaType::QString) {
+        if (listed) {
+            listedStringKeys.insert(key.toString());
+        } else {
+            listedStringKeys.remove(key.toString());
+        }
+    } else if (listed) {
+        listedNumberKeys.insert(key.toULongLong());
+    } else {
+        listedNumberKeys.remove(key.toULongLong());
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::sourceRowsInserted(const QModelIndex &parent, int start, int end)
+{
+    if (!sortKeysValid || parent.isValid()) {
+        return;
+    }
+    if (sortKeyType == NoSortKeys) {
+        // the first rows, they tell the type of the keys
+        invalidateSortKeys();
+        return;
+    }
+
+    const int count = end - start + 1;
+    if (sortKeyType == StringSortKeys) {
+        stringSortKeys.insert(start, count, QString());
+        // the ranks may not have been computed yet, e.g. when only the category filter asked
+        // for the keys
+        if (sortRanksValid) {
+            stringSortRanks.insert(start, count, 0);
+        } else {
+            stringSortRanks.clear();
+        }
+    } else if (sortKeyType == CategoryKeySortKeys) {
+        categoryKeys.insert(start, count, 0);
+    } else {
+        numberSortKeys.insert(start, count, 0);
+    }
+    fetchSortKeys(start, end);
+}
+
+void KCategorizedSortFilterProxyModelPrivate::sourceRowsRemoved(const QModelIndex &parent, int start, int end)
+{
+    if (!sortKeysValid || parent.isValid() || sortKeyType == NoSortKeys) {
+        return;
+    }
+
+    const int count = end - start + 1;
+    if (sortKeyType == StringSortKeys) {
+        stringSortKeys.remove(start, count);
+        // the ranks of the remaining keys keep their order
+        if (sortRanksValid) {
+            stringSortRanks.remove(start, count);
+        }
+    } else if (sortKeyType == CategoryKeySortKeys) {
+        categoryKeys.remove(start, count);
+    } else {
+        numberSortKeys.remove(start, count);
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::layoutChanged()
+{
+    rowMove = RowMove();
+    if (pendingRowMoveSource.isValid()) {
+        const int to = q->mapFromSource(pendingRowMoveSource).row();
+        if (to != -1) {
+            rowMove = {pendingRowMoveFrom, to};
+            removeFromAggregates(rowMove.from, pendingRowMoveSource.row());
+            rowsRemoved(QModelIndex(), rowMove.from, rowMove.from);
+            rowsInserted(QModelIndex(), rowMove.to, rowMove.to);
+            notifyCategoriesChanged(qMin(rowMove.from, rowMove.to) - 1, qMax(rowMove.from, rowMove.to) + 1);
+            return;
+        }
+    }
+    invalidateCategoryRuns();
+    notifyAllCategoriesChanged();
+}
+
+void KCategorizedSortFilterProxyModelPrivate::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+{
+    // if QSortFilterProxyModel sorts a single changed row again, it only moves that row
+    if (topLeft.row() == bottomRight.row() && !topLeft.parent().isValid() && q->dynamicSortFilter() && q->QSortFilterProxyModel::sortColumn() >= 0) {
+        const QModelIndex proxyIndex = q->mapFromSource(topLeft);
+        if (proxyIndex.isValid()) {
+            pendingRowMoveSource = topLeft;
+            pendingRowMoveFrom = proxyIndex.row();
+        }
+    }
+
+    if (!sortKeysValid || sortKeyType == NoSortKeys || topLeft.parent().isValid()) {
+        return;
+    }
+    // category keys may depend on any role of any column
+    if (sortKeyType != CategoryKeySortKeys) {
+        if (!roles.isEmpty() && !roles.contains(KCategorizedSortFilterProxyModel::CategorySortRole)) {
+            return;
+        }
+        if (sortKeysColumn < topLeft.column() || sortKeysColumn > bottomRight.column()) {
+            return;
+        }
+    }
+
+    fetchSortKeys(topLeft.row(), bottomRight.row());
+}
+
+QString KCategorizedSortFilterProxyModelPrivate::fetchCategory(int row) const
+{
+    const QModelIndex categoryIndex = q->index(row, sortColumn);
+    return categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+}
+
+KCategorizedSortFilterProxyModelPrivate::CategoryRun KCategorizedSortFilterProxyModelPrivate::rowCategory(int row)
+{
+    const int sourceRow = keyedRuns || !aggregates.isEmpty() ? q->mapToSource(q->index(row, 0)).row() : -1;
+    CategoryRun run;
+    if (keyedRuns) {
+        const quint64 key = sourceCategoryKey(sourceRow);
+        run = {displayForKey(key, sourceRow), row, 1, key};
+    } else {
+        run = {fetchCategory(row), row, 1};
+    }
+
+    if (!aggregates.isEmpty()) {
+        ensureAggregateValues();
+        run.aggregates.reserve(aggregates.count());
+        for (const CategoryAggregate &aggregate : std::as_const(aggregates)) {
+            run.aggregates.append(aggregate.values.value(sourceRow));
+        }
+    }
+    return run;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::ensureAggregateValues()
+{
+    if (aggregateValuesValid) {
+        return;
+    }
+
+    aggregateValuesValid = true;
+    const QAbstractItemModel *sourceModel = q->sourceModel();
+    const int rowCount = sourceModel ? sourceModel->rowCount() : 0;
+    for (CategoryAggregate &aggregate : aggregates) {
+        aggregate.values.resize(rowCount);
+    }
+    if (rowCount) {
+        fetchAggregateValues(0, rowCount - 1);
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::invalidateAggregateValues()
+{
+    aggregateValuesValid = false;
+    for (CategoryAggregate &aggregate : aggregates) {
+        aggregate.values.clear();
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::fetchAggregateValues(int start, int end)
+{
+    const QAbstractItemModel *sourceModel = q->sourceModel();
+    for (CategoryAggregate &aggregate : aggregates) {
+        for (int row = start; row <= end; ++row) {
+            aggregate.values[row] = sourceModel->index(row, aggregate.column).data(aggregate.role).toDouble();
+        }
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::computeRunAggregates(CategoryRun &run)
+{
+    ensureAggregateValues();
+    run.aggregates.resize(aggregates.count());
+    for (int i = 0; i < aggregates.count(); ++i) {
+        run.aggregates[i] = aggregateIdentity(aggregates.at(i).function);
+    }
+    for (int row = run.firstRow; row < run.firstRow + run.count; ++row) {
+        const int sourceRow = q->mapToSource(q->index(row, 0)).row();
+        for (int i = 0; i < aggregates.count(); ++i) {
+            run.aggregates[i] = combineAggregate(aggregates.at(i).function, run.aggregates.at(i), aggregates.at(i).values.value(sourceRow));
+        }
+    }
+    run.aggregatesValid = true;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::removeFromAggregates(int row, int sourceRow)
+{
+    if (!runsValid || aggregates.isEmpty()) {
+        return;
+    }
+    const int runIndex = runForRow(row);
+    if (runIndex == -1 || !runs[runIndex].aggregatesValid) {
+        return;
+    }
+
+    CategoryRun &run = runs[runIndex];
+    if (!aggregateValuesValid) {
+        run.aggregatesValid = false;
+        return;
+    }
+    for (int i = 0; i < aggregates.count(); ++i) {
+        const double value = aggregates.at(i).values.value(sourceRow);
+        if (aggregates.at(i).function == KCategorizedSortFilterProxyModel::SumAggregate) {
+            run.aggregates[i] -= value;
+        } else if (value == run.aggregates.at(i)) {
+            // the minimum or maximum goes away with its row
+            run.aggregatesValid = false;
+            return;
+        }
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::aggregateSourceRowsInserted(const QModelIndex &parent, int start, int end)
+{
+    if (!aggregateValuesValid || parent.isValid()) {
+        return;
+    }
+
+    for (CategoryAggregate &aggregate : aggregates) {
+        aggregate.values.insert(start, end - start + 1, 0);
+    }
+    fetchAggregateValues(start, end);
+}
+
+void KCategorizedSortFilterProxyModelPrivate::aggregateSourceRowsRemoved(const QModelIndex &parent, int start, int end)
+{
+    if (!aggregateValuesValid || parent.isValid()) {
+        return;
+    }
+
+    for (CategoryAggregate &aggregate : aggregates) {
+        aggregate.values.remove(start, end - start + 1);
+    }
+}
+
+void KCategorizedSortFilterProxyModelPrivate::aggregateSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+{
+    if (!aggregateValuesValid || topLeft.parent().isValid()) {
+        return;
+    }
+
+    const QAbstractItemModel *sourceModel = q->sourceModel();
+    for (int i = 0; i < aggregates.count(); ++i) {
+        CategoryAggregate &aggregate = aggregates[i];
+        if (aggregate.column < topLeft.column() || aggregate.column > bottomRight.column()) {
+            continue;
+        }
+        if (!roles.isEmpty() && !roles.contains(aggregate.role)) {
+            continue;
+        }
+
+        for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+            const double oldValue = aggregate.values.at(row);
+            const double newValue = sourceModel->index(row, aggregate.column).data(aggregate.role).toDouble();
+            aggregate.values[row] = newValue;
+            if (!runsValid || oldValue == newValue) {
+                continue;
+            }
+
+            // the proxy did not handle the change yet, the row is still where it was
+            const int proxyRow = q->mapFromSource(sourceModel->index(row, 0)).row();
+            const int runIndex = proxyRow == -1 ? -1 : runForRow(proxyRow);
+            if (runIndex == -1 || !runs[runIndex].aggregatesValid) {
+                continue;
+            }
+            CategoryRun &run = runs[runIndex];
+            double &value = run.aggregates[i];
+            switch (aggregate.function) {
+            case KCategorizedSortFilterProxyModel::SumAggregate:
+                value += newValue - oldValue;
+                break;
+            case KCategorizedSortFilterProxyModel::MinimumAggregate:
+                if (newValue <= value) {
+                    value = newValue;
+                } else if (oldValue == value) {
+                    run.aggregatesValid = false;
+                }
+                break;
+            case KCategorizedSortFilterProxyModel::MaximumAggregate:
+                if (newValue >= value) {
+                    value = newValue;
+                } else if (oldValue == value) {
+                    run.aggregatesValid = false;
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool KCategorizedSortFilterProxyModelPrivate::usesCategoryKeys()
+{
+    if (categoryKeysState == CategoryKeysUnknown) {
+        const QAbstractItemModel *sourceModel = q->sourceModel();
+        if (!sourceModel || !sourceModel->rowCount()) {
+            // asked again once there are rows
+            return false;
+        }
+        categoryKeysState = q->categoryKey(0) == KCategorizedSortFilterProxyModel::NoCategoryKey ? NoCategoryKeys : HasCategoryKeys;
+    }
+    return categoryKeysState == HasCategoryKeys;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::resetCategoryKeys()
+{
+    categoryKeysState = CategoryKeysUnknown;
+    categoryDisplays.clear();
+}
+
+quint64 KCategorizedSortFilterProxyModelPrivate::sourceCategoryKey(int sourceRow)
+{
+    if (sortKeysValid && sortKeyType == CategoryKeySortKeys) {
+        return categoryKeys.at(sourceRow);
+    }
+    return q->categoryKey(sourceRow);
+}
+
+QString KCategorizedSortFilterProxyModelPrivate::displayForKey(quint64 key, int sourceRow)
+{
+    const auto it = categoryDisplays.constFind(key);
+    if (it != categoryDisplays.constEnd()) {
+        return *it;
+    }
+
+    QString display = q->categoryDisplay(key);
+    if (display.isNull()) {
+        const QModelIndex categoryIndex = q->sourceModel()->index(sourceRow, sortColumn);
+        display = categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+    }
+    categoryDisplays.insert(key, display);
+    return display;
+}
 
 KCategorizedSortFilterProxyModel::KCategorizedSortFilterProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
-    , d(new KCategorizedSortFilterProxyModelPrivate())
+    , d(new KCategorizedSortFilterProxyModelPrivate(this))
 
 {
+    // these are connected before any view gets the chance to, so views always find the
+    // category runs updated when handling these signals
+    connect(this, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &parent, int start, int end) {
+        d->rowsInserted(parent, start, end);
+        if (!parent.isValid()) {
+            d->notifyCategoriesChanged(start - 1, end + 1);
+        }
+    });
+    connect(this, &QAbstractItemModel::rowsAboutToBeRemoved, this, [this](const QModelIndex &parent, int start, int end) {
+        if (parent.isValid() || d->aggregates.isEmpty()) {
+            return;
+        }
+        for (int row = start; row <= end; ++row) {
+            d->removeFromAggregates(row, mapToSource(index(row, 0)).row());
+        }
+    });
+    connect(this, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &parent, int start, int end) {
+        d->rowsRemoved(parent, start, end);
+        if (!parent.isValid()) {
+            d->notifyCategoriesChanged(start - 1, start);
+        }
+    });
+    connect(this, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+        const bool runsWereValid = d->runsValid;
+        d->dataChanged(topLeft, bottomRight, roles);
+        if (runsWereValid && !d->runsValid) {
+            d->notifyAllCategoriesChanged();
+        }
+    });
+    // QSortFilterProxyModel reports the moves of its source as layout changes, only subclasses
+    // moving their own rows get here
+    connect(this, &QAbstractItemModel::rowsMoved, this, [this]() {
+        d->invalidateCategoryRuns();
+        d->notifyAllCategoriesChanged();
+    });
+    connect(this, &QAbstractItemModel::layoutChanged, this, [this]() {
+        d->layoutChanged();
+    });
+    connect(this, &QAbstractItemModel::modelReset, this, [this]() {
+        d->invalidateCategoryRuns();
+        d->notifyAllCategoriesChanged();
+    });
+
 }
 
 KCategorizedSortFilterProxyModel::~KCategorizedSortFilterProxyModel() = default;
 
+void KCategorizedSortFilterProxyModel::setSourceModel(QAbstractItemModel *model)
+{
+    for (const QMetaObject::Connection &connection : std::as_const(d->sourceModelConnections)) {
+        disconnect(connection);
+    }
+    d->sourceModelConnections.clear();
+    d->invalidateSortKeys();
+    d->resetCategoryKeys();
+    d->invalidateAggregateValues();
+
+    // these are connected before QSortFilterProxyModel connects its own, so the sort keys are
+    // up to date when it sorts the changed rows
+    if (model) {
+        const auto invalidateRowValues = [this]() {
+            d->invalidateSortKeys();
+            d->invalidateAggregateValues();
+        };
+        d->sourceModelConnections = {
+            connect(model,
+                    &QAbstractItemModel::rowsInserted,
+                    this,
+                    [this](const QModelIndex &parent, int start, int end) {
+                        d->sourceRowsInserted(parent, start, end);
+                        d->aggregateSourceRowsInserted(parent, start, end);
+                    }),
+            connect(model,
+                    &QAbstractItemModel::rowsRemoved,
+                    this,
+                    [this](const QModelIndex &parent, int start, int end) {
+                        d->sourceRowsRemoved(parent, start, end);
+                        d->aggregateSourceRowsRemoved(parent, start, end);
+                    }),
+            connect(model,
+                    &QAbstractItemModel::dataChanged,
+                    this,
+                    [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                        d->sourceDataChanged(topLeft, bottomRight, roles);
+                        d->aggregateSourceDataChanged(topLeft, bottomRight, roles);
+                    }),
+            connect(model, &QAbstractItemModel::rowsMoved, this, invalidateRowValues),
+            connect(model, &QAbstractItemModel::layoutChanged, this, invalidateRowValues),
+            connect(model,
+                    &QAbstractItemModel::modelReset,
+                    this,
+                    [this]() {
+                        d->invalidateSortKeys();
+                        d->resetCategoryKeys();
+                        d->invalidateAggregateValues();
+                    }),
+        };
+    }
+
+    QSortFilterProxyModel::setSourceModel(model);
+
+    // QSortFilterProxyModel handled the change by now
+    if (model) {
+        d->sourceModelConnections << connect(model, &QAbstractItemModel::dataChanged, this, [this]() {
+            d->pendingRowMoveSource = QPersistentModelIndex();
+            d->pendingRowMoveFrom = -1;
+        });
+    }
+}
+
 void KCategorizedSortFilterProxyModel::sort(int column, Qt::SortOrder order)
 {
     d->sortColumn = column;
     d->sortOrder = order;
+    d->updateCollatorLocale();
+    // a full sort is worth ranking the keys which changed since the last one
+    if (d->unrankedStringKeys) {
+        d->sortRanksValid = false;
+    }
 
+    // QSortFilterProxyModel does nothing if it is sorted that way already
+    const bool sorted = dynamicSortFilter() && QSortFilterProxyModel::sortColumn() == column && QSortFilterProxyModel::sortOrder() == order;
+    if (d->sortMode == ParallelSort && !sorted) {
+        d->computeSortPositions(column);
+    }
     QSortFilterProxyModel::sort(column, order);
+    d->sortPositions.clear();
 }
 
 bool KCategorizedSortFilterProxyModel::isCategorizedModel() const
@@ -61,6 +1253,7 @@ void KCategorizedSortFilterProxyModel::setSortCategoriesByNaturalComparison(bool
     }
 
     d->sortCategoriesByNaturalComparison = sortCategoriesByNaturalComparison;
+    d->sortRanksValid = false;
 
     invalidate();
 }
@@ -70,8 +1263,159 @@ bool KCategorizedSortFilterProxyModel::sortCategoriesByNaturalComparison() const
     return d->sortCategoriesByNaturalComparison;
 }
 
+int KCategorizedSortFilterProxyModel::categoryCount() const
+{
+    return d->categoryRuns().count();
+}
+
+KCategorizedSortFilterProxyModel::Category KCategorizedSortFilterProxyModel::categoryAt(int i) const
+{
+    const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &runs = d->categoryRuns();
+    if (i < 0 || i >= runs.count()) {
+        return Category();
+    }
+    const KCategorizedSortFilterProxyModelPrivate::CategoryRun &run = runs.at(i);
+    const QVariant sortKey = d->keyedRuns ? QVariant(qulonglong(run.key)) : index(run.firstRow, qMax(d->sortColumn, 0)).data(CategorySortRole);
+    return {run.category, sortKey, run.firstRow, run.count};
+}
+
+int KCategorizedSortFilterProxyModel::categoryForRow(int row) const
+{
+    return d->runForRow(row);
+}
+
+int KCategorizedSortFilterProxyModel::addCategoryAggregate(AggregateFunction function, int role, int column)
+{
+    d->aggregates.append({function, role, column, {}});
+    d->invalidateAggregateValues();
+    for (KCategorizedSortFilterProxyModelPrivate::CategoryRun &run : d->runs) {
+        run.aggregatesValid = false;
+    }
+    return d->aggregates.count() - 1;
+}
+
+void KCategorizedSortFilterProxyModel::clearCategoryAggregates()
+{
+    d->aggregates.clear();
+    d->aggregateValuesValid = false;
+    for (KCategorizedSortFilterProxyModelPrivate::CategoryRun &run : d->runs) {
+        run.aggregates.clear();
+        run.aggregatesValid = true;
+    }
+}
+
+double KCategorizedSortFilterProxyModel::categoryAggregate(int category, int aggregate) const
+{
+    const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &runs = d->categoryRuns();
+    if (category < 0 || category >= runs.count() || aggregate < 0 || aggregate >= d->aggregates.count()) {
+        return 0;
+    }
+
+    KCategorizedSortFilterProxyModelPrivate::CategoryRun &run = d->runs[category];
+    if (!run.aggregatesValid) {
+        d->computeRunAggregates(run);
+    }
+    return run.aggregates.at(aggregate);
+}
+
+void KCategorizedSortFilterProxyModel::setAcceptedCategories(const QVariantList &keys)
+{
+    d->categoryFilter = KCategorizedSortFilterProxyModelPrivate::AcceptListedCategories;
+    d->listedNumberKeys.clear();
+    d->listedStringKeys.clear();
+    for (const QVariant &key : keys) {
+        d->setCategoryListed(key, true);
+    }
+
+    invalidateRowsFilter();
+}
+
+void KCategorizedSortFilterProxyModel::setCategoryAccepted(const QVariant &key, bool accepted)
+{
+    if (accepted == isCategoryAccepted(key)) {
+        return;
+    }
+
+    if (d->categoryFilter == KCategorizedSortFilterProxyModelPrivate::NoCategoryFilter) {
+        d->categoryFilter = KCategorizedSortFilterProxyModelPrivate::RejectListedCategories;
+    }
+    // listing the key toggles it in either mode
+    d->setCategoryListed(key, !d->isCategoryListed(key));
+    if (d->categoryFilter == KCategorizedSortFilterProxyModelPrivate::RejectListedCategories && d->listedNumberKeys.isEmpty()
+        && d->listedStringKeys.isEmpty()) {
+        d->categoryFilter = KCategorizedSortFilterProxyModelPrivate::NoCategoryFilter;
+    }
+
+    // the keys are extracted already, the filter only looks them up
+    invalidateRowsFilter();
+}
+
+bool KCategorizedSortFilterProxyModel::isCategoryAccepted(const QVariant &key) const
+{
+    if (d->categoryFilter == KCategorizedSortFilterProxyModelPrivate::NoCategoryFilter) {
+        return true;
+    }
+    return d->isCategoryListed(key) == (d->categoryFilter == KCategorizedSortFilterProxyModelPrivate::AcceptListedCategories);
+}
+
+void KCategorizedSortFilterProxyModel::clearCategoryFilter()
+{
+    if (d->categoryFilter == KCategorizedSortFilterProxyModelPrivate::NoCategoryFilter) {
+        return;
+    }
+
+    d->categoryFilter = KCategorizedSortFilterProxyModelPrivate::NoCategoryFilter;
+    d->listedNumberKeys.clear();
+    d->listedStringKeys.clear();
+
+    invalidateRowsFilter();
+}
+
+QVariant KCategorizedSortFilterProxyModel::data(const QModelIndex &index, int role) const
+{
+    if (role == CategoryDisplayRole && index.isValid() && !index.parent().isValid() && d->usesCategoryKeys()) {
+        const int sourceRow = mapToSource(index).row();
+        return d->displayForKey(d->sourceCategoryKey(sourceRow), sourceRow);
+    }
+    return QSortFilterProxyModel::data(index, role);
+}
+
+void KCategorizedSortFilterProxyModel::setSortMode(SortMode mode)
+{
+    d->sortMode = mode;
+}
+
+KCategorizedSortFilterProxyModel::SortMode KCategorizedSortFilterProxyModel::sortMode() const
+{
+    return d->sortMode;
+}
+
+void KCategorizedSortFilterProxyModel::setSubSortKeyExtractor(const SubSortKeyExtractor &extractor)
+{
+    d->subSortKeyExtractor = extractor;
+}
+
+KCategorizedSortFilterProxyModel::SubSortKeyExtractor KCategorizedSortFilterProxyModel::subSortKeyExtractor() const
+{
+    return d->subSortKeyExtractor;
+}
+
+bool KCategorizedSortFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
+{
+    if (d->categoryFilter != KCategorizedSortFilterProxyModelPrivate::NoCategoryFilter && !source_parent.isValid() && !d->categoryFilterAccepts(source_row)) {
+        return false;
+    }
+    return QSortFilterProxyModel::filterAcceptsRow(source_row, source_parent);
+}
+
 bool KCategorizedSortFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
+    // top level rows were sorted already when sort() runs in ParallelSort mode
+    if (!d->sortPositions.isEmpty() && left.model() == sourceModel() && right.model() == sourceModel() && !left.parent().isValid()
+        && !right.parent().isValid()) {
+        return d->sortPositions.at(left.row()) < d->sortPositions.at(right.row());
+    }
+
     if (d->categorizedModel) {
         int compare = compareCategories(left, right);
 
@@ -92,6 +1436,16 @@ bool KCategorizedSortFilterProxyModel::subSortLessThan(const QModelIndex &left,
 
 int KCategorizedSortFilterProxyModel::compareCategories(const QModelIndex &left, const QModelIndex &right) const
 {
+    // top level rows of the source model compare their extracted keys, without asking the model
+    if (left.model() == sourceModel() && right.model() == sourceModel() && left.column() == right.column() && !left.parent().isValid()
+        && !right.parent().isValid()) {
+        d->ensureSortKeys(left.column());
+        d->ensureSortRanks();
+        if (d->sortKeyType != KCategorizedSortFilterProxyModelPrivate::NoSortKeys) {
+            return d->compareSortKeys(left.row(), right.row());
+        }
+    }
+
     QVariant l = (left.model() ? left.model()->data(left, CategorySortRole) : QVariant());
     QVariant r = (right.model() ? right.model()->data(right, CategorySortRole) : QVariant());
 
@@ -132,4 +1486,16 @@ int KCategorizedSortFilterProxyModel::compareCategories(const QModelIndex &left,
     return 0;
 }
 
+quint64 KCategorizedSortFilterProxyModel::categoryKey(int sourceRow) const
+{
+    Q_UNUSED(sourceRow)
+    return NoCategoryKey;
+}
+
+QString KCategorizedSortFilterProxyModel::categoryDisplay(quint64 key) const
+{
+    Q_UNUSED(key)
+    return QString();
+}
+
 #include "moc_kcategorizedsortfilterproxymodel.cpp"
@@ -10,6 +10,8 @@
 #define KCATEGORIZEDSORTFILTERPROXYMODEL_H
 
 #include <QSortFilterProxyModel>
+#include <functional>
+#include <limits>
 #include <memory>
 
 #include <kitemviews_export.h>
@@ -48,6 +50,88 @@ public:
         CategorySortRole = 0x27857E60,
     };
 
+    /*!
+     * \value StandardSort Rows are sorted by QSortFilterProxyModel, through lessThan().
+     * \value ParallelSort The sort keys of the top level rows are extracted once, and sorted on
+     *        all cores before the proxy applies the resulting order. The categories are compared
+     *        by their CategorySortRole, and rows inside a category by the sortRole() of the sort
+     *        column, or by the keys of subSortKeyExtractor() if set. Reimplementations of
+     *        lessThan(), subSortLessThan() and compareCategories() are not called for the top
+     *        level rows then.
+     *
+     * \since 6.27
+     */
+    enum SortMode {
+        StandardSort = 0,
+        ParallelSort,
+    };
+    Q_ENUM(SortMode)
+
+    /*!
+     * \value SumAggregate The sum of the values of the rows of a category.
+     * \value MinimumAggregate The smallest value of the rows of a category.
+     * \value MaximumAggregate The largest value of the rows of a category.
+     *
+     * \since 6.27
+     */
+    enum AggregateFunction {
+        SumAggregate = 0,
+        MinimumAggregate,
+        MaximumAggregate,
+    };
+    Q_ENUM(AggregateFunction)
+
+    /*!
+     * \typedef KCategorizedSortFilterProxyModel::SubSortKeyExtractor
+     *
+     * A function returning the key by which \a sourceIndex is sorted inside its category, in
+     * ParallelSort mode. Keys must all be numbers, or all be strings. Strings are compared the way
+     * QSortFilterProxyModel compares them.
+     *
+     * \since 6.27
+     */
+    using SubSortKeyExtractor = std::function<QVariant(const QModelIndex &sourceIndex)>;
+
+    /*!
+     * Returned by categoryKey() when the categories are given by the CategorySortRole and
+     * CategoryDisplayRole of the rows instead.
+     *
+     * \since 6.27
+     */
+    static constexpr quint64 NoCategoryKey = std::numeric_limits<quint64>::max();
+
+    /*!
+     * \class KCategorizedSortFilterProxyModel::Category
+     * \inmodule KItemViews
+     *
+     * \brief A range of consecutive top level rows sharing the same category.
+     *
+     * \since 6.27
+     */
+    struct Category {
+        /*!
+         * \variable KCategorizedSortFilterProxyModel::Category::display
+         * The CategoryDisplayRole of the rows.
+         */
+        QString display;
+        /*!
+         * \variable KCategorizedSortFilterProxyModel::Category::sortKey
+         * The CategorySortRole of the first row, or its categoryKey() if the source model has
+         * category keys.
+         */
+        QVariant sortKey;
+        /*!
+         * \variable KCategorizedSortFilterProxyModel::Category::firstRow
+         * The first row of the category, or -1 for an invalid category.
+         */
+        int firstRow = -1;
+        /*!
+         * \variable KCategorizedSortFilterProxyModel::Category::count
+         * The number of rows of the category.
+         */
+        int count = 0;
+    };
+
     /*!
      *
      */
@@ -60,6 +144,12 @@ public:
      */
     void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
+    /*!
+     * Overridden from QSortFilterProxyModel. Sets the given \a model to be processed by the
+     * proxy model.
+     */
+    void setSourceModel(QAbstractItemModel *model) override;
+
     /*!
      * Returns whether the model is categorized or not. Disabled by default.
      */
@@ -96,6 +186,157 @@ public:
      */
     bool sortCategoriesByNaturalComparison() const;
 
+    /*!
+     * Sets the way rows are sorted to \a mode. Defaults to StandardSort.
+     *
+     * ParallelSort is meant for large flat models. When the sort keys are not all numbers or all
+     * strings, sorting silently falls back to StandardSort.
+     *
+     * \since 6.27
+     */
+    void setSortMode(SortMode mode);
+
+    /*!
+     * Returns the way rows are sorted.
+     *
+     * \since 6.27
+     */
+    SortMode sortMode() const;
+
+    /*!
+     * Sets the function returning the keys rows are sorted by inside their categories in
+     * ParallelSort mode. Subclasses reimplementing subSortLessThan() should set one that matches
+     * it. Set an empty function to sort by the sortRole() of the sort column again.
+     *
+     * \since 6.27
+     */
+    void setSubSortKeyExtractor(const SubSortKeyExtractor &extractor);
+
+    /*!
+     * Returns the function extracting the keys rows are sorted by inside their categories, if any.
+     *
+     * \since 6.27
+     */
+    SubSortKeyExtractor subSortKeyExtractor() const;
+
+    /*!
+     * Returns the number of categories of the top level rows.
+     *
+     * Once the model is sorted, all rows of a category are consecutive. Otherwise, a category
+     * shows up once for every range of rows it has.
+     *
+     * \since 6.27
+     */
+    int categoryCount() const;
+
+    /*!
+     * Returns the category at position \a i, between 0 and categoryCount() - 1, from the top.
+     *
+     * \since 6.27
+     */
+    Category categoryAt(int i) const;
+
+    /*!
+     * Returns the position of the category of the top level \a row, or -1 if there is no such row.
+     *
+     * Complexity: O(log(n)) where n is categoryCount().
+     *
+     * \since 6.27
+     */
+    int categoryForRow(int row) const;
+
+    /*!
+     * Adds an aggregate of the \a role of the top level rows in \a column, computed by
+     * \a function for every category, and returns its position for categoryAggregate().
+     *
+     * The values are converted to double, extracted once, and kept up to date along with the
+     * categories, in O(log(n)) per changed row. A minimum or maximum whose row goes away or gets
+     * a worse value is computed again from the rows of its category, the next time it is asked.
+     *
+     * The number of rows of a category is always known, see Category::count.
+     *
+     * \since 6.27
+     */
+    int addCategoryAggregate(AggregateFunction function, int role, int column = 0);
+
+    /*!
+     * Removes all the aggregates added by addCategoryAggregate().
+     *
+     * \since 6.27
+     */
+    void clearCategoryAggregates();
+
+    /*!
+     * Returns the \a aggregate of the category at position \a category, as returned by
+     * categoryForRow(), or 0 if there is no such category or aggregate.
+     *
+     * This is cheap enough to be asked while painting the category headers.
+     *
+     * \since 6.27
+     */
+    double categoryAggregate(int category, int aggregate) const;
+
+    /*!
+     * Only accepts the top level rows of the categories \a keys, on top of filterAcceptsRow().
+     *
+     * A category is given by its categoryKey() when the source model has category keys, and by
+     * its CategorySortRole otherwise, so \a keys are strings if that role gives strings, and
+     * numbers if not. The keys of the rows are extracted once and kept up to date on source model
+     * changes, so filtering does not ask the model for any role.
+     *
+     * \sa setCategoryAccepted(), clearCategoryFilter()
+     * \since 6.27
+     */
+    void setAcceptedCategories(const QVariantList &keys);
+
+    /*!
+     * Shows or hides the rows of the category \a key, leaving the other categories as they are.
+     *
+     * Since the rows of a category are consecutive once sorted, they are removed or inserted as a
+     * single range.
+     *
+     * \sa setAcceptedCategories()
+     * \since 6.27
+     */
+    void setCategoryAccepted(const QVariant &key, bool accepted);
+
+    /*!
+     * Returns whether the rows of the category \a key are accepted by the category filter.
+     *
+     * \since 6.27
+     */
+    bool isCategoryAccepted(const QVariant &key) const;
+
+    /*!
+     * Accepts the rows of all categories again.
+     *
+     * \since 6.27
+     */
+    void clearCategoryFilter();
+
+    /*!
+     * Reimplemented to answer the CategoryDisplayRole of the top level rows from categoryDisplay()
+     * when the source model has category keys.
+     *
+     * \since 6.27
+     */
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+Q_SIGNALS:
+    /*!
+     * Emitted when the categories changed, after the rows were inserted, removed, moved or
+     * changed, but before views get notified of it.
+     *
+     * The categories \a first to \a last are new, or changed their display or count, and some
+     * may have been removed between them. The categories before \a first did not change, the
+     * ones after \a last did not either, but may start at another row.
+     *
+     * Only emitted if it is connected, since the categories have to be computed for it.
+     *
+     * \since 6.27
+     */
+    void categoriesChanged(int first, int last);
+
 protected:
     /*!
      * Overridden from QSortFilterProxyModel. If you are subclassing
@@ -112,6 +353,16 @@ protected:
      */
     bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
 
+    /*!
+     * Overridden from QSortFilterProxyModel. Rejects the top level rows of the categories hidden
+     * by setAcceptedCategories() or setCategoryAccepted(). If you are subclassing
+     * KCategorizedSortFilterProxyModel, call this implementation from yours rather than the one of
+     * QSortFilterProxyModel.
+     *
+     * \since 6.27
+     */
+    bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+
     /*!
      * This method has a similar purpose as lessThan() has on QSortFilterProxyModel.
      * It is used for sorting items that are in the same category.
@@ -147,6 +398,9 @@ protected:
      *          in order to correctly sort categories. You can't mix by returning
      *          a QString for one index, and a qlonglong for other.
      *
+     * \note The CategorySortRole of the top level rows of the source model is only asked
+     *       once, before sorting, and then again when the source model changes it.
+     *
      * \note If you need a more complex layout, you will have to reimplement this
      *       method.
      *
@@ -157,7 +411,39 @@ protected:
      */
     virtual int compareCategories(const QModelIndex &left, const QModelIndex &right) const;
 
+    /*!
+     * Returns the key of the category of the top level \a sourceRow of the source model, or
+     * NoCategoryKey.
+     *
+     * Reimplement this for models whose categories are best told apart by a number, like the value
+     * of an enum. Categories are then sorted by ascending key, and the rows of a category are
+     * found by comparing keys, without asking the model for the CategorySortRole or the
+     * CategoryDisplayRole of every row. Rows with the same key belong to the same category, and
+     * share its categoryDisplay().
+     *
+     * The default implementation returns NoCategoryKey, and the roles are used. This is asked of
+     * the first row only, so either all rows have a key, or none has.
+     *
+     * \note The keys are asked again when the source model changes a row, whatever the roles, and
+     *       must not change otherwise.
+     *
+     * \since 6.27
+     */
+    virtual quint64 categoryKey(int sourceRow) const;
+
+    /*!
+     * Returns the string shown for the category with \a key, as returned by categoryKey().
+     *
+     * The default implementation returns a null string, in which case the CategoryDisplayRole of
+     * the first row found with that key is shown. Either way, this is asked once per key until the
+     * source model is reset, or changes the CategoryDisplayRole of a row.
+     *
+     * \since 6.27
+     */
+    virtual QString categoryDisplay(quint64 key) const;
+
 private:
+    friend class KCategorizedSortFilterProxyModelPrivate;
     std::unique_ptr<KCategorizedSortFilterProxyModelPrivate> const d;
 };
 
@@ -10,14 +10,41 @@
 #define KCATEGORIZEDSORTFILTERPROXYMODEL_P_H
 
 #include <QCollator>
+#include <QHash>
+#include <QSet>
 
 #include "kcategorizedsortfilterproxymodel.h"
 
 class KCategorizedSortFilterProxyModelPrivate
 {
 public:
-    KCategorizedSortFilterProxyModelPrivate()
-        : sortColumn(0)
+    /*
+     * A range of consecutive top level rows sharing the same CategoryDisplayRole, or the same
+     * category key when the runs are keyed.
+     */
+    struct CategoryRun {
+        QString category;
+        int firstRow = 0;
+        int count = 0;
+        quint64 key = 0;
+        // one per aggregate, computed again when not valid
+        QList<double> aggregates;
+        bool aggregatesValid = true;
+    };
+
+    /*
+     * An aggregate of a role, with the value of every top level row of the source model.
+     */
+    struct CategoryAggregate {
+        KCategorizedSortFilterProxyModel::AggregateFunction function;
+        int role;
+        int column;
+        QList<double> values;
+    };
+
+    KCategorizedSortFilterProxyModelPrivate(KCategorizedSortFilterProxyModel *q)
+        : q(q)
+        , sortColumn(0)
         , sortOrder(Qt::AscendingOrder)
         , categorizedModel(false)
         , sortCategoriesByNaturalComparison(true)
@@ -30,11 +57,256 @@ public:
     {
     }
 
+    /*
+     * Returns the private of model, for KCategorizedView to share its category runs.
+     */
+    static KCategorizedSortFilterProxyModelPrivate *get(const KCategorizedSortFilterProxyModel *model)
+    {
+        return model->d.get();
+    }
+
+    /*
+     * Returns the category runs of the top level rows, computing them if needed. They are
+     * computed once and shared by all the views showing this model, which can rely on them being
+     * up to date when they get notified of any row change.
+     */
+    const QList<CategoryRun> &categoryRuns();
+
+    /*
+     * Returns the position in categoryRuns() of the run containing the top level \a row, or -1.
+     *
+     * Complexity: O(log(n)) where n is the number of runs.
+     */
+    int runForRow(int row);
+
+    /*
+     * Returns the CategoryDisplayRole of the top level \a row, without asking the model.
+     */
+    QString categoryForRow(int row);
+
+    void invalidateCategoryRuns();
+
+    /*
+     * Emits categoriesChanged() for the runs containing the top level rows \a firstRow to
+     * \a lastRow, clamped to the existing rows, if it is connected.
+     */
+    void notifyCategoriesChanged(int firstRow, int lastRow);
+
+    /*
+     * Emits categoriesChanged() for all runs, if it is connected.
+     */
+    void notifyAllCategoriesChanged();
+
+    void rowsInserted(const QModelIndex &parent, int start, int end);
+    void rowsRemoved(const QModelIndex &parent, int start, int end);
+    void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+
+    /*
+     * Asks the model for the category of the top level \a row.
+     */
+    QString fetchCategory(int row) const;
+
+    /*
+     * Returns a run of the single top level \a row, with its category.
+     */
+    CategoryRun rowCategory(int row);
+
+    bool sameCategory(const CategoryRun &left, const CategoryRun &right) const;
+    void appendToRuns(QList<CategoryRun> &list, const CategoryRun &row) const;
+
+    /*
+     * Adds the rows of \a run, which follow those of \a into, to \a into.
+     */
+    void mergeRuns(CategoryRun &into, const CategoryRun &run) const;
+
+    /*
+     * Extracts the values of all aggregates for all top level source rows, unless they already
+     * are. They are kept up to date on source model changes from then on.
+     */
+    void ensureAggregateValues();
+    void invalidateAggregateValues();
+    void fetchAggregateValues(int start, int end);
+
+    /*
+     * Computes the aggregates of \a run again from the values of its rows.
+     */
+    void computeRunAggregates(CategoryRun &run);
+
+    /*
+     * Takes the values of the top level \a sourceRow out of the aggregates of the run containing
+     * the top level \a row, before that row goes away.
+     */
+    void removeFromAggregates(int row, int sourceRow);
+
+    void aggregateSourceRowsInserted(const QModelIndex &parent, int start, int end);
+    void aggregateSourceRowsRemoved(const QModelIndex &parent, int start, int end);
+    void aggregateSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+
+    /*
+     * Returns whether the source model has category keys, asking categoryKey() of its first
+     * row if not known yet.
+     */
+    bool usesCategoryKeys();
+
+    /*
+     * Forgets whether the source model has category keys, and their display strings.
+     */
+    void resetCategoryKeys();
+
+    /*
+     * Returns the category key of the top level \a sourceRow, from the sort keys if extracted.
+     */
+    quint64 sourceCategoryKey(int sourceRow);
+
+    /*
+     * Returns the display string of the category \a key, asking for it the first time only.
+     * \a sourceRow is a top level source row with that key.
+     */
+    QString displayForKey(quint64 key, int sourceRow);
+
+    /*
+     * Extracts the CategorySortRole of all top level rows of the source model in \a column, unless
+     * it was already. Keys are kept up to date on source model changes from then on.
+     */
+    void ensureSortKeys(int column);
+    void invalidateSortKeys();
+
+    /*
+     * Extracts the keys of the top level source rows \a start to \a end.
+     */
+    void fetchSortKeys(int start, int end);
+
+    /*
+     * Ranks the distinct string keys in sort order, unless they already are. String keys are
+     * compared through their rank, so the collator only runs once per pair of distinct keys.
+     */
+    void ensureSortRanks();
+
+    /*
+     * Compares two string keys the way KCategorizedSortFilterProxyModel::compareCategories()
+     * does.
+     */
+    int compareStrings(const QString &left, const QString &right) const;
+
+    /*
+     * Compares the category sort keys of the top level source rows \a left and \a right, the way
+     * KCategorizedSortFilterProxyModel::compareCategories() compares their CategorySortRole.
+     * String keys must have been ranked by ensureSortRanks(). Keys which changed since then and
+     * were not ranked are compared with compareStrings().
+     */
+    int compareSortKeys(int left, int right) const;
+
+    /*
+     * Makes the collator follow the default locale. Returns whether the locale changed, in which
+     * case the model has to be sorted again.
+     */
+    bool updateCollatorLocale();
+
+    /*
+     * Computes, in ParallelSort mode, the position of every top level source row once sorted by
+     * \a column. Rows sorting equal share their position. Leaves sortPositions empty if the keys
+     * cannot be sorted this way.
+     */
+    void computeSortPositions(int column);
+
+    /*
+     * Updates the category runs after a layout change. A single row moved to follow its new sort
+     * keys is moved in the runs too, the rest of layout changes drop them.
+     */
+    void layoutChanged();
+
+    /*
+     * Returns whether the category filter accepts the top level \a sourceRow.
+     */
+    bool categoryFilterAccepts(int sourceRow);
+
+    /*
+     * Returns whether the category \a key is listed by the category filter.
+     */
+    bool isCategoryListed(const QVariant &key) const;
+    void setCategoryListed(const QVariant &key, bool listed);
+
+    void sourceRowsInserted(const QModelIndex &parent, int start, int end);
+    void sourceRowsRemoved(const QModelIndex &parent, int start, int end);
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+
+    KCategorizedSortFilterProxyModel *const q;
     int sortColumn;
     Qt::SortOrder sortOrder;
     bool categorizedModel;
     bool sortCategoriesByNaturalComparison;
     QCollator m_collator;
+
+    QList<CategoryRun> runs;
+    bool runsValid = false;
+    // whether the runs were built comparing category keys rather than display strings
+    bool keyedRuns = false;
+
+    enum CategoryKeysState {
+        CategoryKeysUnknown,
+        HasCategoryKeys,
+        NoCategoryKeys,
+    };
+    CategoryKeysState categoryKeysState = CategoryKeysUnknown;
+    // one string per distinct key, shared by all the runs and rows with that key
+    QHash<quint64, QString> categoryDisplays;
+
+    // CategorySortRole is either a string or a number for all rows, unless the source model has
+    // category keys, so only one of these is used
+    enum SortKeyType {
+        NoSortKeys,
+        NumberSortKeys,
+        StringSortKeys,
+        CategoryKeySortKeys,
+    };
+    QList<qlonglong> numberSortKeys;
+    QList<QString> stringSortKeys;
+    QList<quint64> categoryKeys;
+    SortKeyType sortKeyType = NoSortKeys;
+    int sortKeysColumn = 0;
+    bool sortKeysValid = false;
+    // per row, the position of its string key among the distinct ones sorted, or -1 for a key
+    // which was not there when they were ranked
+    QList<int> stringSortRanks;
+    QHash<QString, int> stringKeyRanks;
+    bool sortRanksValid = false;
+    bool unrankedStringKeys = false;
+    QList<QMetaObject::Connection> sourceModelConnections;
+
+    /*
+     * The categories listed by the filter are either the only ones accepted, or the only ones
+     * rejected. Keys are listed as strings or numbers depending on their type, and rows are
+     * looked up in the list of the type of their keys.
+     */
+    enum CategoryFilter {
+        NoCategoryFilter,
+        AcceptListedCategories,
+        RejectListedCategories,
+    };
+    CategoryFilter categoryFilter = NoCategoryFilter;
+    QSet<quint64> listedNumberKeys;
+    QSet<QString> listedStringKeys;
+
+    QList<CategoryAggregate> aggregates;
+    bool aggregateValuesValid = false;
+
+    KCategorizedSortFilterProxyModel::SortMode sortMode = KCategorizedSortFilterProxyModel::StandardSort;
+    KCategorizedSortFilterProxyModel::SubSortKeyExtractor subSortKeyExtractor;
+    // only set while sort() runs in ParallelSort mode
+    QList<int> sortPositions;
+
+    /*
+     * A top level row QSortFilterProxyModel moved, when the sort keys of that single row changed.
+     * It is only valid while layoutChanged is emitted for it, from is the row it had before.
+     */
+    struct RowMove {
+        int from = -1;
+        int to = -1;
+    };
+    RowMove rowMove;
+    // the row whose data is changing, while QSortFilterProxyModel handles that change
+    QPersistentModelIndex pendingRowMoveSource;
+    int pendingRowMoveFrom = -1;
 };
 
 #endif
@@ -19,59 +19,58 @@
 #include "kcategorizedview.h"
 #include "kcategorizedview_p.h"
 
+#include <QDataStream>
+#include <QElapsedTimer>
 #include <QPaintEvent>
 #include <QPainter>
+#include <QPromise>
 #include <QScrollBar>
+#include <QThreadPool>
 
 #include <kitemviews_debug.h>
 
+#include <atomic>
+
 #include "kcategorizedsortfilterproxymodel.h"
+#include "kcategorizedsortfilterproxymodel_p.h"
 #include "kcategorydrawer.h"
+#include "kitemviewsinstrumentation_p.h"
+#include "kitemviewsmemoryusage_p.h"
 
 // BEGIN: Private part
 
-struct KCategorizedViewPrivate::Item {
-    Item()
-        : topLeft(QPoint())
-        , size(QSize())
-    {
-    }
-
-    QPoint topLeft;
-    QSize size;
-};
-
 struct KCategorizedViewPrivate::Block {
     Block()
         : topLeft(QPoint())
-        , firstIndex(QModelIndex())
-        , quarantineStart(QModelIndex())
         , items(QList<Item>())
     {
     }
 
     bool operator!=(const Block &rhs) const
     {
-        return firstIndex != rhs.firstIndex;
+        return firstRow != rhs.firstRow;
     }
 
     static bool lessThan(const Block &left, const Block &right)
     {
-        Q_ASSERT(left.firstIndex.isValid());
-        Q_ASSERT(right.firstIndex.isValid());
-        return left.firstIndex.row() < right.firstIndex.row();
+        Q_ASSERT(left.firstRow != -1);
+        Q_ASSERT(right.firstRow != -1);
+        return left.firstRow < right.firstRow;
     }
 
     QPoint topLeft;
     int height = -1;
-    QPersistentModelIndex firstIndex;
+    // rows are kept up to date by the view itself when rows are inserted or removed. Persistent
+    // indexes would do that for us, but the model would have to update thousands of them on
+    // every change.
+    int firstRow = -1;
     // if we have n elements on this block, and we inserted an element at position i. The quarantine
     // will start at index (i, column, parent). This means that for all elements j where i <= j <= n, the
     // visual rect position of item j will have to be recomputed (cannot use the cached point). The quarantine
     // will only affect the current block, since the rest of blocks can be affected only in the way
     // that the whole block will have different offset, but items will keep the same relative position
-    // in terms of their parent blocks.
-    QPersistentModelIndex quarantineStart;
+    // in terms of their parent blocks. -1 if no item is in quarantine.
+    int quarantineStart = -1;
     QList<Item> items;
 
     // this affects the whole block, not items separately. items contain the topLeft point relative
@@ -84,6 +83,42 @@ struct KCategorizedViewPrivate::Block {
     bool collapsed = false;
 };
 
+// what KCategorizedView::saveLayoutState() writes, and KCategorizedView::restoreLayoutState() reads
+struct KCategorizedViewPrivate::LayoutState {
+    struct BlockState {
+        QString category;
+        int firstRow = 0;
+        bool alternate = false;
+        bool collapsed = false;
+        QPoint topLeft;
+        int height = -1;
+        QList<Item> items;
+    };
+
+    KCategorizedViewLayout::Parameters parameters;
+    int rowCount = 0;
+    QList<BlockState> blocks;
+    // whether blocks were already built from this state, and only the geometry is still pending
+    bool structureApplied = false;
+};
+
+// the geometry of all blocks, computed on worker threads from the item sizes the view knows
+struct KCategorizedViewPrivate::LayoutJob {
+    struct BlockJob {
+        QString category;
+        QList<Item> items;
+    };
+
+    KCategorizedViewLayout layout;
+    std::vector<BlockJob> blocks;
+    QPromise<void> promise;
+    std::atomic<int> remainingBlocks = 0;
+    std::atomic<bool> cancelled = false;
+};
+
+static const quint32 s_layoutStateMagic = 0x4B435653; // "KCVS"
+static const quint8 s_layoutStateVersion = 1;
+
 KCategorizedViewPrivate::KCategorizedViewPrivate(KCategorizedView *qq)
     : q(qq)
     , hoveredBlock(new Block())
@@ -115,7 +150,7 @@ QStyleOptionViewItem KCategorizedViewPrivate::blockRect(const QModelIndex &repre
     QStyleOptionViewItem option = viewOpts();
 
     const int height = categoryDrawer->categoryHeight(representative, option);
-    const QString categoryDisplay = representative.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+    const QString categoryDisplay = categoryForIndex(representative);
     QPoint pos = blockPosition(categoryDisplay);
     pos.ry() -= height;
     option.rect.setTopLeft(pos);
@@ -126,6 +161,13 @@ QStyleOptionViewItem KCategorizedViewPrivate::blockRect(const QModelIndex &repre
     return option;
 }
 
+QRect KCategorizedViewPrivate::headerRect(const QModelIndex &representative)
+{
+    QRect rect = blockRect(representative).rect;
+    rect.setHeight(categoryDrawer->categoryHeight(representative, viewOpts()));
+    return rect;
+}
+
 std::pair<QModelIndex, QModelIndex> KCategorizedViewPrivate::intersectingIndexesWithRect(const QRect &_rect) const
 {
     const int rowCount = proxyModel->rowCount();
@@ -175,19 +217,21 @@ QPoint KCategorizedViewPrivate::blockPosition(const QString &category)
         return block.topLeft;
     }
 
+    KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::BlockPositionRecomputes);
+
     QPoint res(categorySpacing, 0);
 
-    const QModelIndex index = block.firstIndex;
+    const int row = block.firstRow;
 
     for (auto it = blocks.begin(); it != blocks.end(); ++it) {
         Block &block = *it;
-        const QModelIndex categoryIndex = block.firstIndex;
-        if (index.row() < categoryIndex.row()) {
+        if (row < block.firstRow) {
             continue;
         }
 
+        const QModelIndex categoryIndex = proxyModel->index(block.firstRow, q->modelColumn(), q->rootIndex());
         res.ry() += categoryDrawer->categoryHeight(categoryIndex, viewOpts()) + categorySpacing;
-        if (index.row() == categoryIndex.row()) {
+        if (row == block.firstRow) {
             continue;
         }
         res.ry() += blockHeight(it.key());
@@ -211,8 +255,8 @@ int KCategorizedViewPrivate::blockHeight(const QString &category)
         return block.height;
     }
 
-    const QModelIndex firstIndex = block.firstIndex;
-    const QModelIndex lastIndex = proxyModel->index(firstIndex.row() + block.items.count() - 1, q->modelColumn(), q->rootIndex());
+    const QModelIndex firstIndex = proxyModel->index(block.firstRow, q->modelColumn(), q->rootIndex());
+    const QModelIndex lastIndex = proxyModel->index(block.firstRow + block.items.count() - 1, q->modelColumn(), q->rootIndex());
     const QRect topLeft = q->visualRect(firstIndex);
     QRect bottomRight = q->visualRect(lastIndex);
 
@@ -237,20 +281,80 @@ int KCategorizedViewPrivate::viewportWidth() const
 
 void KCategorizedViewPrivate::regenerateAllElements()
 {
+    cancelAsynchronousRelayout();
+    invalidateLayout();
+    KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::QuarantineResets, blocks.count());
     for (QHash<QString, Block>::Iterator it = blocks.begin(); it != blocks.end(); ++it) {
         Block &block = *it;
         block.outOfQuarantine = false;
-        block.quarantineStart = block.firstIndex;
+        block.quarantineStart = block.firstRow;
         block.height = -1;
     }
 }
 
+QSize KCategorizedViewPrivate::sizeHint(const QModelIndex &index) const
+{
+    const int prefetchedRow = index.row() - prefetchedSizeHintsFirstRow;
+    if (prefetchedRow >= 0 && prefetchedRow < prefetchedSizeHints.count()) {
+        return prefetchedSizeHints[prefetchedRow];
+    }
+
+    if (sizeHintsProvider) {
+        QSize size;
+        sizeHintsProvider(index.row(), 1, &size);
+        return size;
+    }
+
+    return q->sizeHintForIndex(index);
+}
+
+void KCategorizedViewPrivate::prefetchSizeHints(int start, int end)
+{
+    if (!sizeHintsProvider) {
+        return;
+    }
+
+    prefetchedSizeHints.resize(end - start + 1);
+    prefetchedSizeHintsFirstRow = start;
+    sizeHintsProvider(start, prefetchedSizeHints.count(), prefetchedSizeHints.data());
+}
+
+void KCategorizedViewPrivate::clearPrefetchedSizeHints()
+{
+    // keeps the capacity around for the next time
+    prefetchedSizeHints.clear();
+}
+
 void KCategorizedViewPrivate::rowsInserted(const QModelIndex &parent, int start, int end)
 {
     if (!isCategorized()) {
         return;
     }
 
+    cancelAsynchronousRelayout();
+
+    prefetchSizeHints(start, end);
+
+    // rows appended at the end, like the batches of models that fetch more rows on demand, do
+    // not move any item that was already laid out
+    const bool appended = end == proxyModel->rowCount(parent) - 1;
+
+    // BEGIN: move the blocks under the inserted rows
+    const int count = end - start + 1;
+    const auto moveBlock = [start, count](Block &block) {
+        if (block.firstRow >= start) {
+            block.firstRow += count;
+        }
+        if (block.quarantineStart >= start) {
+            block.quarantineStart += count;
+        }
+    };
+    for (Block &block : blocks) {
+        moveBlock(block);
+    }
+    moveBlock(*hoveredBlock);
+    // END: move the blocks under the inserted rows
+
     for (int i = start; i <= end; ++i) {
         const QModelIndex index = proxyModel->index(i, q->modelColumn(), parent);
 
@@ -260,19 +364,16 @@ void KCategorizedViewPrivate::rowsInserted(const QModelIndex &parent, int start,
 
         Block &block = blocks[category];
 
-        // BEGIN: update firstIndex
-        // save as firstIndex in block if
+        // BEGIN: update firstRow
+        // save as firstRow in block if
         //     - it forced the category creation (first element on this category)
         //     - it is before the first row on that category
-        const QModelIndex firstIndex = block.firstIndex;
-        if (!firstIndex.isValid() || index.row() < firstIndex.row()) {
-            block.firstIndex = index;
+        if (block.firstRow == -1 || index.row() < block.firstRow) {
+            block.firstRow = index.row();
         }
-        // END: update firstIndex
+        // END: update firstRow
 
-        Q_ASSERT(block.firstIndex.isValid());
-
-        const int firstIndexRow = block.firstIndex.row();
+        const int firstIndexRow = block.firstRow;
 
         block.items.insert(index.row() - firstIndexRow, KCategorizedViewPrivate::Item());
         block.height = -1;
@@ -281,12 +382,15 @@ void KCategorizedViewPrivate::rowsInserted(const QModelIndex &parent, int start,
         q->viewport()->update();
     }
 
+    clearPrefetchedSizeHints();
+
     // BEGIN: update the items that are in quarantine in affected categories
-    {
+    if (!appended) {
         const QModelIndex lastIndex = proxyModel->index(end, q->modelColumn(), parent);
         const QString category = categoryForIndex(lastIndex);
         KCategorizedViewPrivate::Block &block = blocks[category];
-        block.quarantineStart = block.firstIndex;
+        block.quarantineStart = block.firstRow;
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::QuarantineResets);
     }
     // END: update the items that are in quarantine in affected categories
 
@@ -294,28 +398,423 @@ void KCategorizedViewPrivate::rowsInserted(const QModelIndex &parent, int start,
     {
         const QModelIndex firstIndex = proxyModel->index(start, q->modelColumn(), parent);
         const QString category = categoryForIndex(firstIndex);
-        const QModelIndex firstAffectedCategory = blocks[category].firstIndex;
+        const int firstAffectedCategoryRow = blocks[category].firstRow;
         // BEGIN: order for marking as alternate those blocks that are alternate
         QList<Block> blockList = blocks.values();
         std::sort(blockList.begin(), blockList.end(), Block::lessThan);
         QList<int> firstIndexesRows;
         for (const Block &block : std::as_const(blockList)) {
-            firstIndexesRows << block.firstIndex.row();
+            firstIndexesRows << block.firstRow;
         }
         // END: order for marking as alternate those blocks that are alternate
         for (auto it = blocks.begin(); it != blocks.end(); ++it) {
             KCategorizedViewPrivate::Block &block = *it;
-            if (block.firstIndex.row() > firstAffectedCategory.row()) {
+            if (block.firstRow > firstAffectedCategoryRow) {
                 block.outOfQuarantine = false;
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            } else if (block.firstIndex.row() == firstAffectedCategory.row()) {
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
+                block.alternate = firstIndexesRows.indexOf(block.firstRow) % 2;
+            } else if (block.firstRow == firstAffectedCategoryRow) {
+                block.alternate = firstIndexesRows.indexOf(block.firstRow) % 2;
             }
         }
     }
     // END: mark as in quarantine those categories that are under the affected ones
 }
 
+void KCategorizedViewPrivate::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end, const QString &category)
+{
+    cancelAsynchronousRelayout();
+
+    if (end - start + 1 == proxyModel->rowCount()) {
+        blocks.clear();
+        return;
+    }
+
+    // Removal feels a bit more complicated than insertion. Basically we can consider there are
+    // 3 different cases when going to remove items. (*) represents an item, Items between ([) and
+    // (]) are the ones which are marked for removal.
+    //
+    // - 1st case:
+    //              ... * * * * * * [ * * * ...
+    //
+    //   The items marked for removal are the last part of this category. No need to mark any item
+    //   of this category as in quarantine, because no special offset will be pushed to items at
+    //   the right because of any changes (since the removed items are those on the right most part
+    //   of the category).
+    //
+    // - 2nd case:
+    //              ... * * * * * * ] * * * ...
+    //
+    //   The items marked for removal are the first part of this category. We have to mark as in
+    //   quarantine all items in this category. Absolutely all. All items will have to be moved to
+    //   the left (or moving up, because rows got a different offset).
+    //
+    // - 3rd case:
+    //              ... * * [ * * * * ] * * ...
+    //
+    //   The items marked for removal are in between of this category. We have to mark as in
+    //   quarantine only those items that are at the right of the end of the removal interval,
+    //   (starting on "]").
+    //
+    // It hasn't been explicitly said, but when we remove, we have to mark all blocks that are
+    // located under the top most affected category as in quarantine (the block itself, as a whole),
+    // because such a change can force it to have a different offset (note that items themselves
+    // contain relative positions to the block, so marking the block as in quarantine is enough).
+    //
+    // Also note that removal implicitly means that we have to update correctly firstRow of each
+    // block, and in general keep updated the internal information of elements.
+
+    QStringList listOfCategoriesMarkedForRemoval;
+
+    QString lastCategory;
+    int alreadyRemoved = 0;
+    for (int i = start; i <= end; ++i) {
+        const QModelIndex index = proxyModel->index(i, q->modelColumn(), parent);
+
+        Q_ASSERT(index.isValid());
+
+        const QString rowCategory = category.isEmpty() ? categoryForIndex(index) : category;
+
+        if (lastCategory != rowCategory) {
+            lastCategory = rowCategory;
+            alreadyRemoved = 0;
+        }
+
+        KCategorizedViewPrivate::Block &block = blocks[rowCategory];
+        block.items.removeAt(i - block.firstRow - alreadyRemoved);
+        ++alreadyRemoved;
+
+        if (block.items.isEmpty()) {
+            listOfCategoriesMarkedForRemoval << rowCategory;
+        }
+
+        block.height = -1;
+
+        q->viewport()->update();
+    }
+
+    // BEGIN: update the items that are in quarantine in affected categories
+    {
+        const QModelIndex lastIndex = proxyModel->index(end, q->modelColumn(), parent);
+        KCategorizedViewPrivate::Block &block = blocks[category.isEmpty() ? categoryForIndex(lastIndex) : category];
+        if (!block.items.isEmpty() && start <= block.firstRow && end >= block.firstRow) {
+            block.firstRow = end + 1;
+        }
+        block.quarantineStart = block.firstRow;
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::QuarantineResets);
+    }
+    // END: update the items that are in quarantine in affected categories
+
+    for (const QString &category : std::as_const(listOfCategoriesMarkedForRemoval)) {
+        blocks.remove(category);
+    }
+
+    // BEGIN: mark as in quarantine those categories that are under the affected ones
+    {
+        // BEGIN: order for marking as alternate those blocks that are alternate
+        QList<KCategorizedViewPrivate::Block> blockList = blocks.values();
+        std::sort(blockList.begin(), blockList.end(), KCategorizedViewPrivate::Block::lessThan);
+        QList<int> firstIndexesRows;
+        for (const KCategorizedViewPrivate::Block &block : std::as_const(blockList)) {
+            firstIndexesRows << block.firstRow;
+        }
+        // END: order for marking as alternate those blocks that are alternate
+        for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+            KCategorizedViewPrivate::Block &block = *it;
+            if (block.firstRow > start) {
+                block.outOfQuarantine = false;
+                block.alternate = firstIndexesRows.indexOf(block.firstRow) % 2;
+            } else if (block.firstRow == start) {
+                block.alternate = firstIndexesRows.indexOf(block.firstRow) % 2;
+            }
+        }
+    }
+    // END: mark as in quarantine those categories that are under the affected ones
+
+    // BEGIN: move the blocks under the removed rows
+    const int count = end - start + 1;
+    const auto moveRow = [start, end, count](int &row) {
+        if (row > end) {
+            row -= count;
+        } else if (row >= start) {
+            row = start;
+        }
+    };
+    for (KCategorizedViewPrivate::Block &block : blocks) {
+        moveRow(block.firstRow);
+        moveRow(block.quarantineStart);
+    }
+    moveRow(hoveredBlock->firstRow);
+    // END: move the blocks under the removed rows
+}
+
+KItemViewsMemoryUsage KCategorizedViewPrivate::categoryRunsMemoryUsage() const
+{
+    const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &runs = KCategorizedSortFilterProxyModelPrivate::get(proxyModel)->runs;
+    qsizetype bytes = KItemViewsMemory::listBytes(runs);
+    for (const KCategorizedSortFilterProxyModelPrivate::CategoryRun &run : runs) {
+        bytes += KItemViewsMemory::stringBytes(run.category);
+    }
+    return {QStringLiteral("category runs"), runs.count(), bytes};
+}
+
+bool KCategorizedViewPrivate::blocksMatchCategoryRuns() const
+{
+    if (q->rootIndex().isValid()) {
+        return false;
+    }
+
+    const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &runs = KCategorizedSortFilterProxyModelPrivate::get(proxyModel)->categoryRuns();
+    if (runs.count() != blocks.count()) {
+        return false;
+    }
+
+    for (const KCategorizedSortFilterProxyModelPrivate::CategoryRun &run : runs) {
+        const auto it = blocks.constFind(run.category);
+        if (it == blocks.constEnd() || it->firstRow != run.firstRow || it->items.count() != run.count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> *KCategorizedViewPrivate::categoryRuns() const
+{
+    if (!proxyModel || !proxyModel->isCategorizedModel() || q->rootIndex().isValid()) {
+        return nullptr;
+    }
+    return &KCategorizedSortFilterProxyModelPrivate::get(proxyModel)->categoryRuns();
+}
+
+KCategorizedView::BlockRange KCategorizedViewPrivate::blockRange(const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &runs, int ordinal) const
+{
+    if (ordinal < 0 || ordinal >= runs.count()) {
+        return KCategorizedView::BlockRange();
+    }
+    const KCategorizedSortFilterProxyModelPrivate::CategoryRun &run = runs.at(ordinal);
+    // blocks only exist once the view went through the rows, until then nothing is collapsed
+    const auto it = blocks.constFind(run.category);
+    return {run.firstRow, run.count, it != blocks.constEnd() && it->collapsed, ordinal};
+}
+
+bool KCategorizedViewPrivate::moveSortedRow(int from, int to)
+{
+    // the model does not know the category the row had anymore, but its block does
+    QString fromCategory;
+    for (auto it = blocks.cbegin(); it != blocks.cend(); ++it) {
+        if (it->firstRow != -1 && from >= it->firstRow && from < it->firstRow + it->items.count()) {
+            fromCategory = it.key();
+            break;
+        }
+    }
+    if (fromCategory.isEmpty()) {
+        return false;
+    }
+
+    *hoveredBlock = Block();
+    hoveredCategory = QString();
+    hoveredIndex = QModelIndex();
+
+    rowsAboutToBeRemoved(q->rootIndex(), from, from, fromCategory);
+    rowsInserted(q->rootIndex(), to, to);
+    return true;
+}
+
+void KCategorizedViewPrivate::layoutChanged(const QList<QPersistentModelIndex> &parents, QAbstractItemModel::LayoutChangeHint hint)
+{
+    if (!isCategorized()) {
+        return;
+    }
+
+    // the model moved a single row after its sort keys changed, e.g. to another category: only
+    // the blocks it left and joined change
+    const KCategorizedSortFilterProxyModelPrivate::RowMove &rowMove = KCategorizedSortFilterProxyModelPrivate::get(proxyModel)->rowMove;
+    if (rowMove.from != -1 && !q->rootIndex().isValid() && !pendingLayoutState && !blocks.isEmpty()) {
+        if (moveSortedRow(rowMove.from, rowMove.to) && blocksMatchCategoryRuns()) {
+            q->viewport()->update();
+        } else {
+            q->slotLayoutChanged();
+        }
+        return;
+    }
+
+    const bool sortedInPlace = hint == QAbstractItemModel::VerticalSortHint //
+        && (parents.isEmpty() || (parents.count() == 1 && parents.constFirst() == q->rootIndex())) //
+        && !pendingLayoutState && !blocks.isEmpty() && blocksMatchCategoryRuns();
+    if (!sortedInPlace) {
+        q->slotLayoutChanged();
+        return;
+    }
+
+    // rows were only sorted inside their categories: blocks keep their rows, and the persistent
+    // indexes of the view (current, selection) were already remapped by the model. Uniform items
+    // do not change their geometry when swapping places, the rest have to be placed again.
+    hoveredIndex = QModelIndex();
+    if (layout().itemSizing() != KCategorizedViewLayout::UniformSizing) {
+        regenerateAllElements();
+    }
+    q->viewport()->update();
+}
+
+void KCategorizedViewPrivate::scheduleFetchMore()
+{
+    if (fetchMoreScheduled || !isCategorized() || !proxyModel->canFetchMore(q->rootIndex())) {
+        return;
+    }
+
+    fetchMoreScheduled = true;
+    QMetaObject::invokeMethod(
+        q,
+        [this]() {
+            fetchMoreScheduled = false;
+            fetchMoreIfNeeded();
+        },
+        Qt::QueuedConnection);
+}
+
+void KCategorizedViewPrivate::fetchMoreIfNeeded()
+{
+    if (!isCategorized() || !proxyModel->canFetchMore(q->rootIndex())) {
+        return;
+    }
+
+    // ask for the next batch while there is still a page of laid out content below the viewport,
+    // so that it is already there when the user gets to the end
+    const QScrollBar *scrollBar = q->verticalScrollBar();
+    if (scrollBar->maximum() - scrollBar->value() > q->viewport()->height()) {
+        return;
+    }
+
+    proxyModel->fetchMore(q->rootIndex());
+}
+
+bool KCategorizedViewPrivate::startAsynchronousRelayout()
+{
+    cancelAsynchronousRelayout();
+    if (!isCategorized() || blocks.isEmpty() || pendingLayoutState) {
+        return false;
+    }
+
+    invalidateLayout();
+    auto job = std::make_shared<LayoutJob>();
+    job->layout = layout();
+    job->blocks.reserve(blocks.count());
+    for (auto it = blocks.constBegin(); it != blocks.constEnd(); ++it) {
+        if (it->quarantineStart != -1) {
+            return false;
+        }
+        for (const Item &item : it->items) {
+            if (!item.size.isValid()) {
+                return false;
+            }
+        }
+        // shares the items with the block until the worker places them
+        job->blocks.push_back({it.key(), it->items});
+    }
+
+    KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::LayoutSweeps);
+    job->remainingBlocks = int(job->blocks.size());
+    job->promise.start();
+    layoutJobWatcher.setFuture(job->promise.future());
+    runningLayoutJob = job;
+
+    for (std::size_t i = 0; i < job->blocks.size(); ++i) {
+        QThreadPool::globalInstance()->start([job, i]() {
+            if (!job->cancelled) {
+                const KItemViewsInstrumentationPrivate::Span span("KCategorizedView asynchronous block layout");
+                QList<Item> &items = job->blocks[i].items;
+                job->layout.placeBlock(items.data(), items.count());
+            }
+            if (--job->remainingBlocks == 0) {
+                job->promise.finish();
+            }
+        });
+    }
+    return true;
+}
+
+void KCategorizedViewPrivate::cancelAsynchronousRelayout()
+{
+    if (runningLayoutJob) {
+        runningLayoutJob->cancelled = true;
+        runningLayoutJob.reset();
+    }
+}
+
+void KCategorizedViewPrivate::publishAsynchronousRelayout()
+{
+    const std::shared_ptr<LayoutJob> job = std::move(runningLayoutJob);
+    runningLayoutJob.reset();
+    if (!job || job->cancelled) {
+        return;
+    }
+
+    invalidateLayout();
+    if (!(layout().parameters() == job->layout.parameters())) {
+        // the viewport changed again meanwhile
+        if (!startAsynchronousRelayout()) {
+            regenerateAllElements();
+        }
+        return;
+    }
+
+    for (LayoutJob::BlockJob &blockJob : job->blocks) {
+        const auto it = blocks.find(blockJob.category);
+        if (it == blocks.end() || it->items.count() != blockJob.items.count()) {
+            regenerateAllElements();
+            return;
+        }
+        it->items = std::move(blockJob.items);
+        it->quarantineStart = -1;
+        it->height = -1;
+        it->outOfQuarantine = false;
+    }
+
+    q->updateGeometries();
+    q->viewport()->update();
+}
+
+void KCategorizedViewPrivate::deferPaint(int row)
+{
+    if (deferredPaintFirstRow != -1) {
+        deferredPaintFirstRow = qMin(deferredPaintFirstRow, row);
+        deferredPaintLastRow = qMax(deferredPaintLastRow, row);
+        return;
+    }
+
+    deferredPaintFirstRow = row;
+    deferredPaintLastRow = row;
+    QMetaObject::invokeMethod(
+        q,
+        [this]() {
+            paintDeferredItems();
+        },
+        Qt::QueuedConnection);
+}
+
+void KCategorizedViewPrivate::paintDeferredItems()
+{
+    const int first = deferredPaintFirstRow;
+    const int last = qMin(deferredPaintLastRow, isCategorized() ? proxyModel->rowCount(q->rootIndex()) - 1 : -1);
+    deferredPaintFirstRow = -1;
+    deferredPaintLastRow = -1;
+
+    // rows are looked up again, the view may have been scrolled since they were deferred. The
+    // region is made of the rects of the items themselves, and not of their bounding rect, which
+    // in icon mode covers items painted for real already: the follow-up paint would start over
+    // from them and could use up its budget before reaching a deferred item
+    QRegion region;
+    for (int row = first; row <= last; ++row) {
+        region += q->visualRect(proxyModel->index(row, q->modelColumn(), q->rootIndex()));
+    }
+    region &= q->viewport()->rect();
+
+    if (region.isEmpty()) {
+        Q_EMIT q->paintCompleted();
+        return;
+    }
+    q->viewport()->update(region);
+}
+
 QRect KCategorizedViewPrivate::mapToViewport(const QRect &rect) const
 {
     const int dx = -q->horizontalOffset();
@@ -333,7 +832,7 @@ QRect KCategorizedViewPrivate::mapFromViewport(const QRect &rect) const
 int KCategorizedViewPrivate::highestElementInLastRow(const Block &block) const
 {
     // Find the highest element in the last row
-    const QModelIndex lastIndex = proxyModel->index(block.firstIndex.row() + block.items.count() - 1, q->modelColumn(), q->rootIndex());
+    const QModelIndex lastIndex = proxyModel->index(block.firstRow + block.items.count() - 1, q->modelColumn(), q->rootIndex());
     const QRect prevRect = q->visualRect(lastIndex);
     int res = prevRect.height();
     QModelIndex prevIndex = proxyModel->index(lastIndex.row() - 1, q->modelColumn(), q->rootIndex());
@@ -346,7 +845,7 @@ int KCategorizedViewPrivate::highestElementInLastRow(const Block &block) const
             break;
         }
         res = qMax(res, tempRect.height());
-        if (prevIndex == block.firstIndex) {
+        if (prevIndex.row() == block.firstRow) {
             break;
         }
         prevIndex = proxyModel->index(prevIndex.row() - 1, q->modelColumn(), q->rootIndex());
@@ -369,113 +868,172 @@ QString KCategorizedViewPrivate::categoryForIndex(const QModelIndex &index) cons
         return QString();
     }
 
+    // the proxy keeps the categories of its top level rows, shared between all its views
+    if (indexModel == proxyModel && !index.parent().isValid()) {
+        return KCategorizedSortFilterProxyModelPrivate::get(proxyModel)->categoryForRow(index.row());
+    }
+
     const QModelIndex categoryIndex = indexModel->index(index.row(), proxyModel->sortColumn(), index.parent());
     return categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
 }
 
-void KCategorizedViewPrivate::leftToRightVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const
+const KCategorizedViewLayout &KCategorizedViewPrivate::layout()
 {
-    const int firstIndexRow = block.firstIndex.row();
-
-    if (hasGrid()) {
-        const int relativeRow = index.row() - firstIndexRow;
-        const int maxItemsPerRow = qMax(viewportWidth() / q->gridSize().width(), 1);
-        if (q->layoutDirection() == Qt::LeftToRight) {
-            item.topLeft.rx() = (relativeRow % maxItemsPerRow) * q->gridSize().width() + blockPos.x() + categoryDrawer->leftMargin();
+    if (itemLayoutDirty) {
+        KCategorizedViewLayout::Parameters parameters;
+        if (hasGrid()) {
+            parameters.itemSizing = KCategorizedViewLayout::GridSizing;
+        } else if (q->uniformItemSizes()) {
+            parameters.itemSizing = KCategorizedViewLayout::UniformSizing;
         } else {
-            item.topLeft.rx() = viewportWidth() - ((relativeRow % maxItemsPerRow) + 1) * q->gridSize().width() + categoryDrawer->leftMargin() + categorySpacing;
+            parameters.itemSizing = KCategorizedViewLayout::VariableSizing;
         }
-        item.topLeft.ry() = (relativeRow / maxItemsPerRow) * q->gridSize().height();
-    } else {
-        if (q->uniformItemSizes()) {
-            const int relativeRow = index.row() - firstIndexRow;
-            const QSize itemSize = q->sizeHintForIndex(index);
-            const int maxItemsPerRow = qMax((viewportWidth() - q->spacing()) / (itemSize.width() + q->spacing()), 1);
-            if (q->layoutDirection() == Qt::LeftToRight) {
-                item.topLeft.rx() = (relativeRow % maxItemsPerRow) * itemSize.width() + blockPos.x() + categoryDrawer->leftMargin();
-            } else {
-                item.topLeft.rx() = viewportWidth() - (relativeRow % maxItemsPerRow) * itemSize.width() + categoryDrawer->leftMargin() + categorySpacing;
-            }
-            item.topLeft.ry() = (relativeRow / maxItemsPerRow) * itemSize.height();
-        } else {
-            const QSize currSize = q->sizeHintForIndex(index);
-            if (index != block.firstIndex) {
-                const int viewportW = viewportWidth() - q->spacing();
-                QModelIndex prevIndex = proxyModel->index(index.row() - 1, q->modelColumn(), q->rootIndex());
-                QRect prevRect = q->visualRect(prevIndex);
-                prevRect = mapFromViewport(prevRect);
-                if ((prevRect.bottomRight().x() + 1) + currSize.width() - blockPos.x() + q->spacing() > viewportW) {
-                    // we have to check the whole previous row, and see which one was the
-                    // highest.
-                    Q_FOREVER {
-                        prevIndex = proxyModel->index(prevIndex.row() - 1, q->modelColumn(), q->rootIndex());
-                        const QRect tempRect = q->visualRect(prevIndex);
-                        if (tempRect.topLeft().y() < prevRect.topLeft().y()) {
-                            break;
-                        }
-                        if (tempRect.bottomRight().y() > prevRect.bottomRight().y()) {
-                            prevRect = tempRect;
-                        }
-                        if (prevIndex == block.firstIndex) {
-                            break;
-                        }
-                    }
-                    if (q->layoutDirection() == Qt::LeftToRight) {
-                        item.topLeft.rx() = categoryDrawer->leftMargin() + blockPos.x() + q->spacing();
-                    } else {
-                        item.topLeft.rx() = viewportWidth() - currSize.width() + categoryDrawer->leftMargin() + categorySpacing;
-                    }
-                    item.topLeft.ry() = (prevRect.bottomRight().y() + 1) + q->spacing() - blockPos.y();
-                } else {
-                    if (q->layoutDirection() == Qt::LeftToRight) {
-                        item.topLeft.rx() = (prevRect.bottomRight().x() + 1) + q->spacing();
-                    } else {
-                        item.topLeft.rx() = (prevRect.bottomLeft().x() - 1) - q->spacing() - item.size.width() + categoryDrawer->leftMargin() + categorySpacing;
-                    }
-                    item.topLeft.ry() = prevRect.topLeft().y() - blockPos.y();
-                }
-            } else {
-                if (q->layoutDirection() == Qt::LeftToRight) {
-                    item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin() + q->spacing();
-                } else {
-                    item.topLeft.rx() = viewportWidth() - currSize.width() + categoryDrawer->leftMargin() + categorySpacing;
-                }
-                item.topLeft.ry() = q->spacing();
-            }
+        parameters.layoutDirection = q->layoutDirection();
+        parameters.flow = q->flow();
+        parameters.gridSize = q->gridSize();
+        parameters.spacing = q->spacing();
+        parameters.categorySpacing = categorySpacing;
+        parameters.leftMargin = categoryDrawer->leftMargin();
+        parameters.viewportWidth = viewportWidth();
+        itemLayout = KCategorizedViewLayout(parameters);
+        itemLayoutDirty = false;
+    }
+    return itemLayout;
+}
+
+void KCategorizedViewPrivate::invalidateLayout()
+{
+    itemLayoutDirty = true;
+}
+
+std::unique_ptr<KCategorizedViewPrivate::LayoutState> KCategorizedViewPrivate::readLayoutState(const QByteArray &data, const QByteArray &modelFingerprint)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint8 version = 0;
+    QByteArray fingerprint;
+    stream >> magic >> version >> fingerprint;
+    if (magic != s_layoutStateMagic || version != s_layoutStateVersion || fingerprint != modelFingerprint) {
+        return nullptr;
+    }
+
+    auto state = std::make_unique<LayoutState>();
+    KCategorizedViewLayout::Parameters &parameters = state->parameters;
+    qint32 itemSizing = 0;
+    qint32 layoutDirection = 0;
+    qint32 flow = 0;
+    qint32 rowCount = 0;
+    quint32 blockCount = 0;
+    stream >> itemSizing >> layoutDirection >> flow >> parameters.gridSize;
+    stream >> parameters.spacing >> parameters.categorySpacing >> parameters.leftMargin >> parameters.viewportWidth;
+    stream >> rowCount >> blockCount;
+    parameters.itemSizing = static_cast<KCategorizedViewLayout::ItemSizing>(itemSizing);
+    parameters.layoutDirection = static_cast<Qt::LayoutDirection>(layoutDirection);
+    parameters.flow = static_cast<QListView::Flow>(flow);
+    state->rowCount = rowCount;
+    if (stream.status() != QDataStream::Ok || rowCount < 0 || blockCount > quint32(rowCount)) {
+        return nullptr;
+    }
+
+    int coveredRows = 0;
+    state->blocks.resize(blockCount);
+    for (LayoutState::BlockState &block : state->blocks) {
+        qint32 itemCount = 0;
+        stream >> block.category >> block.firstRow >> itemCount >> block.alternate >> block.collapsed >> block.topLeft >> block.height;
+        // every item takes 16 bytes, do not allocate more than what the data can hold
+        if (stream.status() != QDataStream::Ok || itemCount <= 0 || itemCount > rowCount - coveredRows
+            || qint64(itemCount) * 16 > stream.device()->bytesAvailable()) {
+            return nullptr;
         }
+        block.items.resize(itemCount);
+        for (Item &item : block.items) {
+            stream >> item.topLeft >> item.size;
+        }
+        coveredRows += itemCount;
+    }
+
+    if (stream.status() != QDataStream::Ok || coveredRows != rowCount) {
+        return nullptr;
     }
-    item.size = q->sizeHintForIndex(index);
+
+    return state;
 }
 
-void KCategorizedViewPrivate::topToBottomVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const
+bool KCategorizedViewPrivate::applyPendingLayoutState()
 {
-    const int firstIndexRow = block.firstIndex.row();
+    if (!pendingLayoutState) {
+        return false;
+    }
 
-    if (hasGrid()) {
-        const int relativeRow = index.row() - firstIndexRow;
-        item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin();
-        item.topLeft.ry() = relativeRow * q->gridSize().height();
-    } else {
-        if (q->uniformItemSizes()) {
-            const int relativeRow = index.row() - firstIndexRow;
-            const QSize itemSize = q->sizeHintForIndex(index);
-            item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin();
-            item.topLeft.ry() = relativeRow * itemSize.height();
+    std::unique_ptr<LayoutState> state = std::move(pendingLayoutState);
+    if (state->structureApplied || state->rowCount != proxyModel->rowCount(q->rootIndex())) {
+        return false;
+    }
+
+    // the fingerprint is the caller's promise, but check that every block still starts where
+    // it used to. This only costs one data() call per category.
+    for (const LayoutState::BlockState &blockState : std::as_const(state->blocks)) {
+        const QModelIndex firstIndex = proxyModel->index(blockState.firstRow, q->modelColumn(), q->rootIndex());
+        if (!firstIndex.isValid() || categoryForIndex(firstIndex) != blockState.category) {
+            return false;
+        }
+    }
+
+    const bool sameLayout = layout().parameters() == state->parameters;
+    blocks.clear();
+    blocks.reserve(state->blocks.count());
+    for (const LayoutState::BlockState &blockState : std::as_const(state->blocks)) {
+        Block &block = blocks[blockState.category];
+        block.firstRow = blockState.firstRow;
+        block.items = blockState.items;
+        block.alternate = blockState.alternate;
+        block.collapsed = blockState.collapsed;
+        if (sameLayout) {
+            block.topLeft = blockState.topLeft;
+            block.height = blockState.height;
+            block.outOfQuarantine = true;
         } else {
-            if (index != block.firstIndex) {
-                QModelIndex prevIndex = proxyModel->index(index.row() - 1, q->modelColumn(), q->rootIndex());
-                QRect prevRect = q->visualRect(prevIndex);
-                prevRect = mapFromViewport(prevRect);
-                item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin() + q->spacing();
-                item.topLeft.ry() = (prevRect.bottomRight().y() + 1) + q->spacing() - blockPos.y();
-            } else {
-                item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin() + q->spacing();
-                item.topLeft.ry() = q->spacing();
-            }
+            block.quarantineStart = block.firstRow;
+        }
+    }
+
+    if (!sameLayout) {
+        // keep it around until the view gets the size it had when the state was saved
+        state->structureApplied = true;
+        pendingLayoutState = std::move(state);
+    }
+
+    q->viewport()->update();
+    return true;
+}
+
+void KCategorizedViewPrivate::applyPendingLayoutGeometry()
+{
+    if (!pendingLayoutState || !pendingLayoutState->structureApplied || !isCategorized()) {
+        return;
+    }
+
+    if (layout().parameters() != pendingLayoutState->parameters) {
+        return;
+    }
+
+    const std::unique_ptr<LayoutState> state = std::move(pendingLayoutState);
+    for (const LayoutState::BlockState &blockState : std::as_const(state->blocks)) {
+        auto it = blocks.find(blockState.category);
+        if (it == blocks.end() || it->firstRow != blockState.firstRow || it->items.count() != blockState.items.count()) {
+            // blocks changed after all, let them be computed again
+            regenerateAllElements();
+            return;
         }
+        Block &block = *it;
+        block.items = blockState.items;
+        block.topLeft = blockState.topLeft;
+        block.height = blockState.height;
+        block.outOfQuarantine = true;
+        block.quarantineStart = -1;
     }
-    item.size = q->sizeHintForIndex(index);
-    item.size.setWidth(viewportWidth());
 }
 
 void KCategorizedViewPrivate::_k_slotCollapseOrExpandClicked(QModelIndex)
@@ -490,6 +1048,12 @@ KCategorizedView::KCategorizedView(QWidget *parent)
     : QListView(parent)
     , d(new KCategorizedViewPrivate(this))
 {
+    connect(&d->layoutJobWatcher, &QFutureWatcher<void>::finished, this, [this]() {
+        d->publishAsynchronousRelayout();
+    });
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() {
+        d->scheduleFetchMore();
+    });
 }
 
 KCategorizedView::~KCategorizedView() = default;
@@ -501,15 +1065,29 @@ void KCategorizedView::setModel(QAbstractItemModel *model)
     }
 
     d->blocks.clear();
+    d->cancelAsynchronousRelayout();
+    d->invalidateLayout();
 
-    if (d->proxyModel) {
-        disconnect(d->proxyModel, SIGNAL(layoutChanged()), this, SLOT(slotLayoutChanged()));
+    for (const QMetaObject::Connection &connection : std::as_const(d->proxyModelConnections)) {
+        disconnect(connection);
     }
+    d->proxyModelConnections.clear();
 
     d->proxyModel = dynamic_cast<KCategorizedSortFilterProxyModel *>(model);
 
+    // connected before QListView gets the model, so the blocks are up to date when it relayouts
     if (d->proxyModel) {
-        connect(d->proxyModel, SIGNAL(layoutChanged()), this, SLOT(slotLayoutChanged()));
+        d->proxyModelConnections = {
+            connect(d->proxyModel,
+                    &QAbstractItemModel::layoutChanged,
+                    this,
+                    [this](const QList<QPersistentModelIndex> &parents, QAbstractItemModel::LayoutChangeHint hint) {
+                        d->layoutChanged(parents, hint);
+                    }),
+            // QSortFilterProxyModel reports the moves of its source as layout changes, only
+            // subclasses moving their own rows get here, and they are laid out again
+            connect(d->proxyModel, &QAbstractItemModel::rowsMoved, this, &KCategorizedView::slotLayoutChanged),
+        };
     }
 
     QListView::setModel(model);
@@ -548,37 +1126,48 @@ QRect KCategorizedView::visualRect(const QModelIndex &index) const
     }
 
     KCategorizedViewPrivate::Block &block = d->blocks[category];
-    const int firstIndexRow = block.firstIndex.row();
+    const int firstIndexRow = block.firstRow;
 
-    Q_ASSERT(block.firstIndex.isValid());
+    Q_ASSERT(block.firstRow != -1);
 
     if (index.row() - firstIndexRow < 0 || index.row() - firstIndexRow >= block.items.count()) {
         return QRect();
     }
 
     const QPoint blockPos = d->blockPosition(category);
-
-    KCategorizedViewPrivate::Item &ritem = block.items[index.row() - firstIndexRow];
-
-    if (ritem.topLeft.isNull() //
-        || (block.quarantineStart.isValid() && index.row() >= block.quarantineStart.row())) {
-        if (flow() == LeftToRight) {
-            d->leftToRightVisualRect(index, ritem, block, blockPos);
-        } else {
-            d->topToBottomVisualRect(index, ritem, block, blockPos);
+    const KCategorizedViewLayout &itemLayout = d->layout();
+    const int relativeRow = index.row() - firstIndexRow;
+
+    KCategorizedViewPrivate::Item &ritem = block.items[relativeRow];
+
+    const auto needsPlacing = [&block](int itemRow) {
+        return block.items.at(itemRow).topLeft.isNull() || (block.quarantineStart != -1 && block.firstRow + itemRow >= block.quarantineStart);
+    };
+    if (needsPlacing(relativeRow)) {
+        // items with variable sizes flow after the previous ones, the ones which are not in place
+        // yet are placed first. This is done in order rather than recursively, as after a resize
+        // that can be all the items of the block.
+        int firstPlacedRow = relativeRow;
+        if (itemLayout.itemSizing() == KCategorizedViewLayout::VariableSizing) {
+            while (firstPlacedRow > 0 && needsPlacing(firstPlacedRow - 1)) {
+                --firstPlacedRow;
+            }
+        }
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::VisualRectMisses, relativeRow - firstPlacedRow + 1);
+        for (int row = firstPlacedRow; row < relativeRow; ++row) {
+            const QModelIndex placedIndex = d->proxyModel->index(firstIndexRow + row, modelColumn(), rootIndex());
+            itemLayout.placeItem(block.items.data(), row, d->sizeHint(placedIndex));
         }
+        itemLayout.placeItem(block.items.data(), relativeRow, d->sizeHint(index));
 
         // BEGIN: update the quarantine start
-        const bool wasLastIndex = (index.row() == (block.firstIndex.row() + block.items.count() - 1));
-        if (index.row() == block.quarantineStart.row()) {
-            if (wasLastIndex) {
-                block.quarantineStart = QModelIndex();
-            } else {
-                const QModelIndex nextIndex = d->proxyModel->index(index.row() + 1, modelColumn(), rootIndex());
-                block.quarantineStart = nextIndex;
-            }
+        const bool wasLastIndex = (index.row() == (block.firstRow + block.items.count() - 1));
+        if (block.quarantineStart >= firstIndexRow + firstPlacedRow && block.quarantineStart <= index.row()) {
+            block.quarantineStart = wasLastIndex ? -1 : index.row() + 1;
         }
         // END: update the quarantine start
+    } else {
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::VisualRectHits);
     }
 
     // we get now the absolute position through the relative position of the parent block. do not
@@ -588,8 +1177,8 @@ QRect KCategorizedView::visualRect(const QModelIndex &index) const
 
     const QSize sizeHint = item.size;
 
-    if (d->hasGrid()) {
-        const QSize sizeGrid = gridSize();
+    if (itemLayout.itemSizing() == KCategorizedViewLayout::GridSizing) {
+        const QSize sizeGrid = itemLayout.parameters().gridSize;
         const QSize resultingSize = sizeHint.boundedTo(sizeGrid);
         QRect res(item.topLeft.x() + ((sizeGrid.width() - resultingSize.width()) / 2), item.topLeft.y(), resultingSize.width(), resultingSize.height());
         if (block.collapsed) {
@@ -623,6 +1212,7 @@ void KCategorizedView::setCategoryDrawer(KCategoryDrawer *categoryDrawer)
     }
 
     d->categoryDrawer = categoryDrawer;
+    d->invalidateLayout();
 
     connect(d->categoryDrawer, SIGNAL(collapseOrExpandClicked(QModelIndex)), this, SLOT(_k_slotCollapseOrExpandClicked(QModelIndex)));
 }
@@ -639,6 +1229,7 @@ void KCategorizedView::setCategorySpacing(int categorySpacing)
     }
 
     d->categorySpacing = categorySpacing;
+    d->invalidateLayout();
 
     for (auto it = d->blocks.begin(); it != d->blocks.end(); ++it) {
         KCategorizedViewPrivate::Block &block = *it;
@@ -680,12 +1271,14 @@ void KCategorizedView::setCollapsibleBlocks(bool enable)
 QModelIndexList KCategorizedView::block(const QString &category)
 {
     QModelIndexList res;
-    const KCategorizedViewPrivate::Block &block = d->blocks[category];
-    if (block.height == -1) {
+    const auto it = d->blocks.constFind(category);
+    if (it == d->blocks.constEnd() || it->height == -1) {
         return res;
     }
-    QModelIndex current = block.firstIndex;
-    const int first = current.row();
+    const KCategorizedViewPrivate::Block &block = *it;
+    res.reserve(block.items.count());
+    const int first = block.firstRow;
+    QModelIndex current = d->proxyModel->index(first, modelColumn(), rootIndex());
     for (int i = 1; i <= block.items.count(); ++i) {
         if (current.isValid()) {
             res << current;
@@ -700,6 +1293,191 @@ QModelIndexList KCategorizedView::block(const QModelIndex &representative)
     return block(representative.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString());
 }
 
+int KCategorizedView::blockCount() const
+{
+    const auto runs = d->categoryRuns();
+    return runs ? runs->count() : 0;
+}
+
+QString KCategorizedView::blockCategory(int ordinal) const
+{
+    const auto runs = d->categoryRuns();
+    if (!runs || ordinal < 0 || ordinal >= runs->count()) {
+        return QString();
+    }
+    return runs->at(ordinal).category;
+}
+
+KCategorizedView::BlockRange KCategorizedView::blockRangeAt(int ordinal) const
+{
+    const auto runs = d->categoryRuns();
+    return runs ? d->blockRange(*runs, ordinal) : BlockRange();
+}
+
+KCategorizedView::BlockRange KCategorizedView::blockRange(const QString &category) const
+{
+    const auto runs = d->categoryRuns();
+    if (!runs) {
+        return BlockRange();
+    }
+
+    // a block, if there is one, tells where to look for the run
+    const auto it = d->blocks.constFind(category);
+    if (it != d->blocks.constEnd() && it->firstRow != -1) {
+        const int ordinal = KCategorizedSortFilterProxyModelPrivate::get(d->proxyModel)->runForRow(it->firstRow);
+        if (ordinal != -1 && runs->at(ordinal).category == category) {
+            return d->blockRange(*runs, ordinal);
+        }
+    }
+    for (int ordinal = 0; ordinal < runs->count(); ++ordinal) {
+        if (runs->at(ordinal).category == category) {
+            return d->blockRange(*runs, ordinal);
+        }
+    }
+    return BlockRange();
+}
+
+KCategorizedView::BlockRange KCategorizedView::blockRange(const QModelIndex &representative) const
+{
+    const auto runs = d->categoryRuns();
+    if (!runs || representative.model() != d->proxyModel || representative.parent().isValid()) {
+        return BlockRange();
+    }
+    return d->blockRange(*runs, KCategorizedSortFilterProxyModelPrivate::get(d->proxyModel)->runForRow(representative.row()));
+}
+
+void KCategorizedView::setSizeHintsProvider(const SizeHintsProvider &provider)
+{
+    d->sizeHintsProvider = provider;
+    d->regenerateAllElements();
+    viewport()->update();
+}
+
+KCategorizedView::SizeHintsProvider KCategorizedView::sizeHintsProvider() const
+{
+    return d->sizeHintsProvider;
+}
+
+void KCategorizedView::setPaintBudget(int milliseconds)
+{
+    d->paintBudget = qMax(milliseconds, 0);
+}
+
+int KCategorizedView::paintBudget() const
+{
+    return d->paintBudget;
+}
+
+void KCategorizedView::setAsynchronousLayout(bool enable)
+{
+    d->asynchronousLayout = enable;
+    if (!enable) {
+        d->cancelAsynchronousRelayout();
+    }
+}
+
+bool KCategorizedView::asynchronousLayout() const
+{
+    return d->asynchronousLayout;
+}
+
+QList<KItemViewsMemoryUsage> KCategorizedView::memoryUsage() const
+{
+    using namespace KItemViewsMemory;
+
+    qsizetype keyBytes = 0;
+    qsizetype itemCount = 0;
+    qsizetype itemBytes = 0;
+    for (auto it = d->blocks.constBegin(); it != d->blocks.constEnd(); ++it) {
+        keyBytes += stringBytes(it.key());
+        itemCount += it->items.count();
+        itemBytes += listBytes(it->items);
+    }
+
+    QList<KItemViewsMemoryUsage> res{
+        {QStringLiteral("blocks"), d->blocks.count(), hashBytes(d->blocks)},
+        {QStringLiteral("category keys"), d->blocks.count(), keyBytes},
+        {QStringLiteral("block items"), itemCount, itemBytes},
+        {QStringLiteral("prefetched size hints"), d->prefetchedSizeHints.count(), listBytes(d->prefetchedSizeHints)},
+    };
+
+    if (d->pendingLayoutState) {
+        qsizetype stateBytes = listBytes(d->pendingLayoutState->blocks);
+        for (const KCategorizedViewPrivate::LayoutState::BlockState &blockState : std::as_const(d->pendingLayoutState->blocks)) {
+            stateBytes += stringBytes(blockState.category) + listBytes(blockState.items);
+        }
+        res.append({QStringLiteral("pending layout state"), d->pendingLayoutState->blocks.count(), stateBytes});
+    }
+
+    if (d->runningLayoutJob) {
+        // items are shared with the blocks until the workers place them
+        const std::vector<KCategorizedViewPrivate::LayoutJob::BlockJob> &blockJobs = d->runningLayoutJob->blocks;
+        res.append({QStringLiteral("asynchronous layout"),
+                    qsizetype(blockJobs.size()),
+                    qsizetype(blockJobs.capacity() * sizeof(KCategorizedViewPrivate::LayoutJob::BlockJob))});
+    }
+
+    if (d->proxyModel) {
+        res.append(d->categoryRunsMemoryUsage());
+    }
+
+    return res;
+}
+
+void KCategorizedView::dumpMemoryUsage() const
+{
+    KItemViewsMemory::dump(this, memoryUsage());
+}
+
+QByteArray KCategorizedView::saveLayoutState(const QByteArray &modelFingerprint) const
+{
+    if (!d->isCategorized()) {
+        return QByteArray();
+    }
+
+    // make sure that no item is left in quarantine
+    const int rowCount = d->proxyModel->rowCount(rootIndex());
+    for (int row = 0; row < rowCount; ++row) {
+        visualRect(d->proxyModel->index(row, modelColumn(), rootIndex()));
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    const KCategorizedViewLayout::Parameters &parameters = d->layout().parameters();
+    stream << s_layoutStateMagic << s_layoutStateVersion << modelFingerprint;
+    stream << qint32(parameters.itemSizing) << qint32(parameters.layoutDirection) << qint32(parameters.flow) << parameters.gridSize;
+    stream << qint32(parameters.spacing) << qint32(parameters.categorySpacing) << qint32(parameters.leftMargin) << qint32(parameters.viewportWidth);
+    stream << qint32(rowCount) << quint32(d->blocks.count());
+
+    for (auto it = d->blocks.begin(); it != d->blocks.end(); ++it) {
+        const QPoint topLeft = d->blockPosition(it.key());
+        d->blockHeight(it.key());
+        const KCategorizedViewPrivate::Block &block = *it;
+        stream << it.key() << qint32(block.firstRow) << qint32(block.items.count()) << block.alternate << block.collapsed << topLeft
+               << qint32(block.height);
+        for (const KCategorizedViewPrivate::Item &item : block.items) {
+            stream << item.topLeft << item.size;
+        }
+    }
+
+    return data;
+}
+
+bool KCategorizedView::restoreLayoutState(const QByteArray &state, const QByteArray &modelFingerprint)
+{
+    d->pendingLayoutState = KCategorizedViewPrivate::readLayoutState(state, modelFingerprint);
+    if (!d->pendingLayoutState) {
+        return false;
+    }
+
+    if (d->isCategorized() && d->proxyModel->rowCount(rootIndex())) {
+        slotLayoutChanged();
+    }
+    return true;
+}
+
 QModelIndex KCategorizedView::indexAt(const QPoint &point) const
 {
     if (!d->isCategorized()) {
@@ -718,6 +1496,7 @@ QModelIndex KCategorizedView::indexAt(const QPoint &point) const
         const int middle = (bottom + top) / 2;
         const QModelIndex index = d->proxyModel->index(middle, modelColumn(), rootIndex());
         const QRect rect = visualRect(index);
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::IndexAtProbes);
         if (rect.contains(point)) {
             if (index.model()->flags(index) & Qt::ItemIsEnabled) {
                 return index;
@@ -777,9 +1556,19 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
 {
     if (!d->isCategorized()) {
         QListView::paintEvent(event);
+        Q_EMIT paintCompleted();
         return;
     }
 
+    const KItemViewsInstrumentationPrivate::Span span("KCategorizedView::paintEvent");
+    KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::Paints);
+
+    QElapsedTimer paintTimer;
+    if (d->paintBudget) {
+        paintTimer.start();
+    }
+    bool paintDeferred = false;
+
     const std::pair<QModelIndex, QModelIndex> intersecting = d->intersectingIndexesWithRect(viewport()->rect().intersected(event->rect()));
 
     QPainter p(viewport());
@@ -791,7 +1580,7 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
     auto it = d->blocks.constBegin();
     while (it != d->blocks.constEnd()) {
         const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+        const QModelIndex categoryIndex = d->proxyModel->index(block.firstRow, d->proxyModel->sortColumn(), rootIndex());
 
         QStyleOptionViewItem option = d->viewOpts();
         option.features |= d->alternatingBlockColors && block.alternate //
@@ -827,9 +1616,9 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
             // BEGIN: first check if the block is collapsed. if so, we have to skip the item painting
             if (i == indexToCheckIfBlockCollapsed) {
                 categoryIndex = d->proxyModel->index(i, d->proxyModel->sortColumn(), rootIndex());
-                category = categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+                category = d->categoryForIndex(categoryIndex);
                 block = &d->blocks[category];
-                indexToCheckIfBlockCollapsed = block->firstIndex.row() + block->items.count();
+                indexToCheckIfBlockCollapsed = block->firstRow + block->items.count();
                 if (block->collapsed) {
                     i = indexToCheckIfBlockCollapsed;
                     continue;
@@ -839,7 +1628,7 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
 
             Q_ASSERT(block);
 
-            const bool alternateItem = (i - block->firstIndex.row()) % 2;
+            const bool alternateItem = (i - block->firstRow) % 2;
 
             const QModelIndex index = d->proxyModel->index(i, modelColumn(), rootIndex());
             const Qt::ItemFlags flags = d->proxyModel->flags(index);
@@ -860,7 +1649,22 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
                 option.state |= (index == d->hoveredIndex) ? QStyle::State_MouseOver : QStyle::State_None;
             }
 
+            if (!event->region().intersects(option.rect)) {
+                // clipped away, e.g. an item painted already next to those of a follow-up paint
+                ++i;
+                continue;
+            }
+
+            if (paintDeferred) {
+                // out of budget, draw a placeholder and leave the item for a follow-up paint
+                style()->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, &p, this);
+                d->deferPaint(i);
+                ++i;
+                continue;
+            }
+
             itemDelegateForIndex(index)->paint(&p, option, index);
+            paintDeferred = d->paintBudget && paintTimer.hasExpired(d->paintBudget);
             ++i;
         }
         // END: draw items
@@ -880,11 +1684,18 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
     // END: draw selection rect
 
     p.restore();
+
+    if (d->deferredPaintFirstRow == -1) {
+        Q_EMIT paintCompleted();
+    }
 }
 
 void KCategorizedView::resizeEvent(QResizeEvent *event)
 {
-    d->regenerateAllElements();
+    if (!d->asynchronousLayout || !d->startAsynchronousRelayout()) {
+        d->regenerateAllElements();
+    }
+    d->applyPendingLayoutGeometry();
     QListView::resizeEvent(event);
 }
 
@@ -934,7 +1745,17 @@ void KCategorizedView::setSelection(const QRect &rect, QItemSelectionModel::Sele
 void KCategorizedView::mouseMoveEvent(QMouseEvent *event)
 {
     QListView::mouseMoveEvent(event);
+    const QModelIndex previousHoveredIndex = d->hoveredIndex;
     d->hoveredIndex = indexAt(event->pos());
+    if (d->hoveredIndex != previousHoveredIndex) {
+        // only the items that gained or lost the hover state need to be repainted
+        if (previousHoveredIndex.isValid()) {
+            viewport()->update(visualRect(previousHoveredIndex));
+        }
+        if (d->hoveredIndex.isValid()) {
+            viewport()->update(visualRect(d->hoveredIndex));
+        }
+    }
     const SelectionMode itemViewSelectionMode = selectionMode();
     if (state() == DragSelectingState //
         && isSelectionRectVisible() //
@@ -951,7 +1772,7 @@ void KCategorizedView::mouseMoveEvent(QMouseEvent *event)
     auto it = d->blocks.constBegin();
     while (it != d->blocks.constEnd()) {
         const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+        const QModelIndex categoryIndex = d->proxyModel->index(block.firstRow, d->proxyModel->sortColumn(), rootIndex());
         QStyleOptionViewItem option(d->viewOpts());
         const int height = d->categoryDrawer->categoryHeight(categoryIndex, option);
         QPoint pos = d->blockPosition(it.key());
@@ -962,31 +1783,36 @@ void KCategorizedView::mouseMoveEvent(QMouseEvent *event)
         option.rect = d->mapToViewport(option.rect);
         const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
         if (option.rect.contains(mousePos)) {
+            // BEGIN: repaint only the headers of the blocks whose hover state changed
             if (d->hoveredBlock->height != -1 && *d->hoveredBlock != block) {
-                const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-                const QStyleOptionViewItem option = d->blockRect(categoryIndex);
-                d->categoryDrawer->mouseLeft(categoryIndex, option.rect);
+                const QModelIndex hoveredCategoryIndex = d->proxyModel->index(d->hoveredBlock->firstRow, d->proxyModel->sortColumn(), rootIndex());
+                const QStyleOptionViewItem hoveredOption = d->blockRect(hoveredCategoryIndex);
+                d->categoryDrawer->mouseLeft(hoveredCategoryIndex, hoveredOption.rect);
+                viewport()->update(d->headerRect(hoveredCategoryIndex));
                 *d->hoveredBlock = block;
                 d->hoveredCategory = it.key();
-                viewport()->update(option.rect);
+                viewport()->update(d->headerRect(categoryIndex));
             } else if (d->hoveredBlock->height == -1) {
                 *d->hoveredBlock = block;
                 d->hoveredCategory = it.key();
+                viewport()->update(d->headerRect(categoryIndex));
             } else {
+                // nothing changed for the view. Drawers that paint hover feedback on their own
+                // are responsible for requesting the repaint of the area they changed.
                 d->categoryDrawer->mouseMoved(categoryIndex, option.rect, event);
             }
-            viewport()->update(option.rect);
+            // END: repaint only the headers of the blocks whose hover state changed
             return;
         }
         ++it;
     }
     if (d->hoveredBlock->height != -1) {
-        const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+        const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstRow, d->proxyModel->sortColumn(), rootIndex());
         const QStyleOptionViewItem option = d->blockRect(categoryIndex);
         d->categoryDrawer->mouseLeft(categoryIndex, option.rect);
         *d->hoveredBlock = KCategorizedViewPrivate::Block();
         d->hoveredCategory = QString();
-        viewport()->update(option.rect);
+        viewport()->update(d->headerRect(categoryIndex));
     }
 }
 
@@ -1004,7 +1830,7 @@ void KCategorizedView::mousePressEvent(QMouseEvent *event)
     auto it = d->blocks.constBegin();
     while (it != d->blocks.constEnd()) {
         const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+        const QModelIndex categoryIndex = d->proxyModel->index(block.firstRow, d->proxyModel->sortColumn(), rootIndex());
         const QStyleOptionViewItem option = d->blockRect(categoryIndex);
         const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
         if (option.rect.contains(mousePos)) {
@@ -1031,7 +1857,7 @@ void KCategorizedView::mouseReleaseEvent(QMouseEvent *event)
     auto it = d->blocks.constBegin();
     while (it != d->blocks.constEnd()) {
         const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+        const QModelIndex categoryIndex = d->proxyModel->index(block.firstRow, d->proxyModel->sortColumn(), rootIndex());
         const QStyleOptionViewItem option = d->blockRect(categoryIndex);
         const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
         if (option.rect.contains(mousePos)) {
@@ -1055,12 +1881,12 @@ void KCategorizedView::leaveEvent(QEvent *event)
         d->hoveredIndex = QModelIndex();
     }
     if (d->categoryDrawer && d->hoveredBlock->height != -1) {
-        const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+        const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstRow, d->proxyModel->sortColumn(), rootIndex());
         const QStyleOptionViewItem option = d->blockRect(categoryIndex);
         d->categoryDrawer->mouseLeft(categoryIndex, option.rect);
         *d->hoveredBlock = KCategorizedViewPrivate::Block();
         d->hoveredCategory = QString();
-        viewport()->update(option.rect);
+        viewport()->update(d->headerRect(categoryIndex));
     }
 }
 
@@ -1136,17 +1962,17 @@ QModelIndex KCategorizedView::moveCursor(CursorAction cursorAction, Qt::Keyboard
     case MoveDown: {
         if (d->hasGrid() || uniformItemSizes()) {
             const QModelIndex current = currentIndex();
-            const QSize itemSize = d->hasGrid() ? gridSize() : sizeHintForIndex(current);
+            const QSize itemSize = d->hasGrid() ? gridSize() : d->sizeHint(current);
             const KCategorizedViewPrivate::Block &block = d->blocks[d->categoryForIndex(current)];
             const int maxItemsPerRow = qMax(d->viewportWidth() / itemSize.width(), 1);
-            const bool canMove = current.row() + maxItemsPerRow < block.firstIndex.row() + block.items.count();
+            const bool canMove = current.row() + maxItemsPerRow < block.firstRow + block.items.count();
 
             if (canMove) {
                 return d->proxyModel->index(current.row() + maxItemsPerRow, modelColumn(), rootIndex());
             }
 
-            const int currentRelativePos = (current.row() - block.firstIndex.row()) % maxItemsPerRow;
-            const QModelIndex nextIndex = d->proxyModel->index(block.firstIndex.row() + block.items.count(), modelColumn(), rootIndex());
+            const int currentRelativePos = (current.row() - block.firstRow) % maxItemsPerRow;
+            const QModelIndex nextIndex = d->proxyModel->index(block.firstRow + block.items.count(), modelColumn(), rootIndex());
 
             if (!nextIndex.isValid()) {
                 return QModelIndex();
@@ -1159,7 +1985,7 @@ QModelIndex KCategorizedView::moveCursor(CursorAction cursorAction, Qt::Keyboard
             }
 
             if (currentRelativePos < (block.items.count() % maxItemsPerRow)) {
-                return d->proxyModel->index(nextBlock.firstIndex.row() + currentRelativePos, modelColumn(), rootIndex());
+                return d->proxyModel->index(nextBlock.firstRow + currentRelativePos, modelColumn(), rootIndex());
             }
         }
         return QModelIndex();
@@ -1167,17 +1993,17 @@ QModelIndex KCategorizedView::moveCursor(CursorAction cursorAction, Qt::Keyboard
     case MoveUp: {
         if (d->hasGrid() || uniformItemSizes()) {
             const QModelIndex current = currentIndex();
-            const QSize itemSize = d->hasGrid() ? gridSize() : sizeHintForIndex(current);
+            const QSize itemSize = d->hasGrid() ? gridSize() : d->sizeHint(current);
             const KCategorizedViewPrivate::Block &block = d->blocks[d->categoryForIndex(current)];
             const int maxItemsPerRow = qMax(d->viewportWidth() / itemSize.width(), 1);
-            const bool canMove = current.row() - maxItemsPerRow >= block.firstIndex.row();
+            const bool canMove = current.row() - maxItemsPerRow >= block.firstRow;
 
             if (canMove) {
                 return d->proxyModel->index(current.row() - maxItemsPerRow, modelColumn(), rootIndex());
             }
 
-            const int currentRelativePos = (current.row() - block.firstIndex.row()) % maxItemsPerRow;
-            const QModelIndex prevIndex = d->proxyModel->index(block.firstIndex.row() - 1, modelColumn(), rootIndex());
+            const int currentRelativePos = (current.row() - block.firstRow) % maxItemsPerRow;
+            const QModelIndex prevIndex = d->proxyModel->index(block.firstRow - 1, modelColumn(), rootIndex());
 
             if (!prevIndex.isValid()) {
                 return QModelIndex();
@@ -1191,7 +2017,7 @@ QModelIndex KCategorizedView::moveCursor(CursorAction cursorAction, Qt::Keyboard
 
             const int remainder = prevBlock.items.count() % maxItemsPerRow;
             if (currentRelativePos < remainder) {
-                return d->proxyModel->index(prevBlock.firstIndex.row() + prevBlock.items.count() - remainder + currentRelativePos, modelColumn(), rootIndex());
+                return d->proxyModel->index(prevBlock.firstRow + prevBlock.items.count() - remainder + currentRelativePos, modelColumn(), rootIndex());
             }
 
             return QModelIndex();
@@ -1214,113 +2040,8 @@ void KCategorizedView::rowsAboutToBeRemoved(const QModelIndex &parent, int start
 
     *d->hoveredBlock = KCategorizedViewPrivate::Block();
     d->hoveredCategory = QString();
-
-    if (end - start + 1 == d->proxyModel->rowCount()) {
-        d->blocks.clear();
-        QListView::rowsAboutToBeRemoved(parent, start, end);
-        return;
-    }
-
-    // Removal feels a bit more complicated than insertion. Basically we can consider there are
-    // 3 different cases when going to remove items. (*) represents an item, Items between ([) and
-    // (]) are the ones which are marked for removal.
-    //
-    // - 1st case:
-    //              ... * * * * * * [ * * * ...
-    //
-    //   The items marked for removal are the last part of this category. No need to mark any item
-    //   of this category as in quarantine, because no special offset will be pushed to items at
-    //   the right because of any changes (since the removed items are those on the right most part
-    //   of the category).
-    //
-    // - 2nd case:
-    //              ... * * * * * * ] * * * ...
-    //
-    //   The items marked for removal are the first part of this category. We have to mark as in
-    //   quarantine all items in this category. Absolutely all. All items will have to be moved to
-    //   the left (or moving up, because rows got a different offset).
-    //
-    // - 3rd case:
-    //              ... * * [ * * * * ] * * ...
-    //
-    //   The items marked for removal are in between of this category. We have to mark as in
-    //   quarantine only those items that are at the right of the end of the removal interval,
-    //   (starting on "]").
-    //
-    // It hasn't been explicitly said, but when we remove, we have to mark all blocks that are
-    // located under the top most affected category as in quarantine (the block itself, as a whole),
-    // because such a change can force it to have a different offset (note that items themselves
-    // contain relative positions to the block, so marking the block as in quarantine is enough).
-    //
-    // Also note that removal implicitly means that we have to update correctly firstIndex of each
-    // block, and in general keep updated the internal information of elements.
-
-    QStringList listOfCategoriesMarkedForRemoval;
-
-    QString lastCategory;
-    int alreadyRemoved = 0;
-    for (int i = start; i <= end; ++i) {
-        const QModelIndex index = d->proxyModel->index(i, modelColumn(), parent);
-
-        Q_ASSERT(index.isValid());
-
-        const QString category = d->categoryForIndex(index);
-
-        if (lastCategory != category) {
-            lastCategory = category;
-            alreadyRemoved = 0;
-        }
-
-        KCategorizedViewPrivate::Block &block = d->blocks[category];
-        block.items.removeAt(i - block.firstIndex.row() - alreadyRemoved);
-        ++alreadyRemoved;
-
-        if (block.items.isEmpty()) {
-            listOfCategoriesMarkedForRemoval << category;
-        }
-
-        block.height = -1;
-
-        viewport()->update();
-    }
-
-    // BEGIN: update the items that are in quarantine in affected categories
-    {
-        const QModelIndex lastIndex = d->proxyModel->index(end, modelColumn(), parent);
-        const QString category = d->categoryForIndex(lastIndex);
-        KCategorizedViewPrivate::Block &block = d->blocks[category];
-        if (!block.items.isEmpty() && start <= block.firstIndex.row() && end >= block.firstIndex.row()) {
-            block.firstIndex = d->proxyModel->index(end + 1, modelColumn(), parent);
-        }
-        block.quarantineStart = block.firstIndex;
-    }
-    // END: update the items that are in quarantine in affected categories
-
-    for (const QString &category : std::as_const(listOfCategoriesMarkedForRemoval)) {
-        d->blocks.remove(category);
-    }
-
-    // BEGIN: mark as in quarantine those categories that are under the affected ones
-    {
-        // BEGIN: order for marking as alternate those blocks that are alternate
-        QList<KCategorizedViewPrivate::Block> blockList = d->blocks.values();
-        std::sort(blockList.begin(), blockList.end(), KCategorizedViewPrivate::Block::lessThan);
-        QList<int> firstIndexesRows;
-        for (const KCategorizedViewPrivate::Block &block : std::as_const(blockList)) {
-            firstIndexesRows << block.firstIndex.row();
-        }
-        // END: order for marking as alternate those blocks that are alternate
-        for (auto it = d->blocks.begin(); it != d->blocks.end(); ++it) {
-            KCategorizedViewPrivate::Block &block = *it;
-            if (block.firstIndex.row() > start) {
-                block.outOfQuarantine = false;
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            } else if (block.firstIndex.row() == start) {
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            }
-        }
-    }
-    // END: mark as in quarantine those categories that are under the affected ones
+    d->pendingLayoutState.reset();
+    d->rowsAboutToBeRemoved(parent, start, end);
 
     QListView::rowsAboutToBeRemoved(parent, start, end);
 }
@@ -1353,6 +2074,9 @@ void KCategorizedView::updateGeometries()
     }
     // END bugs 213068, 287847 --------------------------------------------------------------
 
+    // flow, spacing and layout direction changes end up relayouting the view through here
+    d->invalidateLayout();
+
     QListView::updateGeometries();
 
     if (!d->isCategorized()) {
@@ -1380,11 +2104,11 @@ void KCategorizedView::updateGeometries()
         lastItemRect.setSize(lastItemRect.size().expandedTo(gridSize()));
     } else {
         if (uniformItemSizes()) {
-            QSize itemSize = sizeHintForIndex(lastIndex);
+            QSize itemSize = d->sizeHint(lastIndex);
             itemSize.setHeight(itemSize.height() + spacing());
             lastItemRect.setSize(itemSize);
         } else {
-            QSize itemSize = sizeHintForIndex(lastIndex);
+            QSize itemSize = d->sizeHint(lastIndex);
             const QString category = d->categoryForIndex(lastIndex);
             itemSize.setHeight(d->highestElementInLastRow(d->blocks[category]) + spacing());
             lastItemRect.setSize(itemSize);
@@ -1402,6 +2126,9 @@ void KCategorizedView::updateGeometries()
     verticalScrollBar()->setRange(0, bottomRange);
     verticalScrollBar()->setValue(oldVerticalOffset);
 
+    // the content may not even fill the viewport yet if the model is still fetching its rows
+    d->scheduleFetchMore();
+
     // TODO: also consider working with the horizontal scroll bar. since at this level I am not still
     //      supporting "top to bottom" flow, there is no real problem. If I support that someday
     //      (think how to draw categories), we would have to take care of the horizontal scroll bar too.
@@ -1438,6 +2165,8 @@ void KCategorizedView::dataChanged(const QModelIndex &topLeft, const QModelIndex
 
     *d->hoveredBlock = KCategorizedViewPrivate::Block();
     d->hoveredCategory = QString();
+    d->pendingLayoutState.reset();
+    d->cancelAsynchronousRelayout();
 
     // BEGIN: since the model changed data, we need to reconsider item sizes
     int i = topLeft.row();
@@ -1449,10 +2178,11 @@ void KCategorizedView::dataChanged(const QModelIndex &topLeft, const QModelIndex
         const QModelIndex currIndex = d->proxyModel->index(i, modelColumn(), rootIndex());
         if (i == indexToCheck) {
             categoryIndex = d->proxyModel->index(i, d->proxyModel->sortColumn(), rootIndex());
-            category = categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+            category = d->categoryForIndex(categoryIndex);
             block = &d->blocks[category];
-            block->quarantineStart = currIndex;
-            indexToCheck = block->firstIndex.row() + block->items.count();
+            block->quarantineStart = i;
+            KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::QuarantineResets);
+            indexToCheck = block->firstRow + block->items.count();
         }
         visualRect(currIndex);
         ++i;
@@ -1469,6 +2199,7 @@ void KCategorizedView::rowsInserted(const QModelIndex &parent, int start, int en
 
     *d->hoveredBlock = KCategorizedViewPrivate::Block();
     d->hoveredCategory = QString();
+    d->pendingLayoutState.reset();
     d->rowsInserted(parent, start, end);
 }
 
@@ -1478,10 +2209,14 @@ void KCategorizedView::slotLayoutChanged()
         return;
     }
 
+    const KItemViewsInstrumentationPrivate::Span span("KCategorizedView::slotLayoutChanged");
+    KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::LayoutSweeps);
+
     d->blocks.clear();
+    d->cancelAsynchronousRelayout();
     *d->hoveredBlock = KCategorizedViewPrivate::Block();
     d->hoveredCategory = QString();
-    if (d->proxyModel->rowCount()) {
+    if (d->proxyModel->rowCount() && !d->applyPendingLayoutState()) {
         d->rowsInserted(rootIndex(), 0, d->proxyModel->rowCount() - 1);
     }
 }
@@ -9,9 +9,11 @@
 #define KCATEGORIZEDVIEW_H
 
 #include <QListView>
+#include <functional>
 #include <memory>
 
 #include <kitemviews_export.h>
+#include <kitemviewsmemoryusage.h>
 
 class KCategoryDrawer;
 
@@ -55,7 +57,8 @@ class KCategoryDrawer;
  *       Have present that this role is asked (n * log n) times when sorting and compared. Comparing
  *       ints is always faster than comparing strings, without mattering how fast the string
  *       comparison is. Consider thinking of a way of returning ints instead of QStrings if your
- *       model can contain a high number of items.
+ *       model can contain a high number of items. Models whose categories are like an enum can
+ *       also reimplement KCategorizedSortFilterProxyModel::categoryKey(), which spares both roles.
  *
  * \warning Note that for really drawing items in blocks you will need some things to be done:
  * \list
@@ -197,6 +200,219 @@ public:
      */
     QModelIndexList block(const QModelIndex &representative);
 
+    /*!
+     * \class KCategorizedView::BlockRange
+     * \inmodule KItemViews
+     *
+     * \brief The rows of the model in a category, as returned by blockRange().
+     *
+     * \since 6.27
+     */
+    struct BlockRange {
+        /*!
+         * \variable KCategorizedView::BlockRange::firstRow
+         * The first row of the category, or -1 if the range is not valid.
+         */
+        int firstRow = -1;
+        /*!
+         * \variable KCategorizedView::BlockRange::count
+         * The number of consecutive rows in the category.
+         */
+        int count = 0;
+        /*!
+         * \variable KCategorizedView::BlockRange::collapsed
+         * Whether the block of the category is collapsed.
+         */
+        bool collapsed = false;
+        /*!
+         * \variable KCategorizedView::BlockRange::ordinal
+         * The position of the category among all categories, from top to bottom.
+         */
+        int ordinal = -1;
+
+        /*!
+         * Returns whether the range belongs to a category of the model.
+         */
+        bool isValid() const
+        {
+            return firstRow != -1;
+        }
+    };
+
+    /*!
+     * Returns the number of categories in the model.
+     *
+     * Unlike block(), this and the other range functions below do not depend on the items having
+     * been laid out, and allocate nothing.
+     *
+     * \since 6.27
+     */
+    int blockCount() const;
+
+    /*!
+     * Returns the category at \a ordinal, between 0 and blockCount() - 1, from top to bottom.
+     *
+     * \since 6.27
+     */
+    QString blockCategory(int ordinal) const;
+
+    /*!
+     * Returns the rows of the category at \a ordinal, between 0 and blockCount() - 1.
+     *
+     * \since 6.27
+     */
+    BlockRange blockRangeAt(int ordinal) const;
+
+    /*!
+     * Returns the rows in \a category, or an invalid range if there is no such category.
+     *
+     * Acting on the rows of a category through this range, e.g. selecting them with a single
+     * QItemSelectionRange, avoids creating an index for each of them as block() does.
+     *
+     * \since 6.27
+     */
+    BlockRange blockRange(const QString &category) const;
+
+    /*!
+     * Returns the rows in the category of \a representative.
+     *
+     * Complexity: O(log(n)) where n is the number of categories.
+     *
+     * \since 6.27
+     */
+    BlockRange blockRange(const QModelIndex &representative) const;
+
+    /*!
+     * \typedef KCategorizedView::SizeHintsProvider
+     *
+     * A function that writes into \a sizes the size hints of the \a count rows of the model
+     * starting at \a firstRow. \a sizes points to a buffer of \a count elements owned by the
+     * view.
+     *
+     * \since 6.27
+     */
+    using SizeHintsProvider = std::function<void(int firstRow, int count, QSize *sizes)>;
+
+    /*!
+     * Sets a function that provides the size hints of whole row ranges at once.
+     *
+     * When laying out items, the view asks the item delegate for the size hint of each index
+     * separately. Models that already know the sizes of their items can set a \a provider, that
+     * the view will call once for all the rows it lays out at the same time instead. Rows are
+     * rows of the model set on the view, under rootIndex().
+     *
+     * The sizes returned must be the ones the item delegate would return. Set an empty function
+     * to ask the item delegate again.
+     *
+     * \since 6.27
+     */
+    void setSizeHintsProvider(const SizeHintsProvider &provider);
+
+    /*!
+     * Returns the function providing size hints for row ranges, if any.
+     *
+     * \since 6.27
+     */
+    SizeHintsProvider sizeHintsProvider() const;
+
+    /*!
+     * Saves the computed layout of the view: the blocks of every category and the geometry of
+     * all their items.
+     *
+     * \a modelFingerprint identifies the contents of the model, it is up to the caller to make it
+     * change whenever rows, their order, their categories or their sizes change. The layout
+     * state is also tied to the current viewport width, spacing, grid size and flow.
+     *
+     * Returns an empty QByteArray if the view is not categorized.
+     *
+     * \sa restoreLayoutState()
+     * \since 6.27
+     */
+    QByteArray saveLayoutState(const QByteArray &modelFingerprint) const;
+
+    /*!
+     * Restores a layout saved with saveLayoutState(), so that reopening a large model does not
+     * need to compute its layout again.
+     *
+     * The state is only used if \a modelFingerprint matches the saved one, and if the model set
+     * on the view has the same row count and the same category at the start of every block. It
+     * can be restored before or after setting the model. If the view is not yet at the size it
+     * had when the state was saved, the categories are restored right away and the item geometry
+     * once the view gets that size, unless the model changes meanwhile.
+     *
+     * \a state can wrap memory mapped from a file with QByteArray::fromRawData(), it is not
+     * accessed after this method returns.
+     *
+     * Returns whether the state was valid and matched \a modelFingerprint.
+     *
+     * \sa saveLayoutState()
+     * \since 6.27
+     */
+    bool restoreLayoutState(const QByteArray &state, const QByteArray &modelFingerprint);
+
+    /*!
+     * Sets the time in milliseconds a single paint of the view may spend in item delegates.
+     *
+     * Once the budget is used up, the items that are left are drawn as placeholders showing only
+     * their background, and painted for real on a follow-up update. This keeps the view
+     * responsive with delegates that are expensive to paint. At least one item is painted for
+     * real every time, so the view always makes progress.
+     *
+     * 0, the default, disables the budget.
+     *
+     * \sa paintCompleted()
+     * \since 6.27
+     */
+    void setPaintBudget(int milliseconds);
+
+    /*!
+     * Returns the time in milliseconds a single paint of the view may spend in item delegates,
+     * or 0 if there is no limit.
+     *
+     * \since 6.27
+     */
+    int paintBudget() const;
+
+    /*!
+     * Sets whether the view lays out its items again on worker threads when it gets resized.
+     *
+     * Once all items have been laid out, their positions only depend on their sizes, the
+     * categories and the viewport, so after a resize they can be computed from a snapshot of
+     * them, one task per category on QThreadPool::globalInstance(). Until the new geometry is
+     * ready, the view keeps painting the previous one. Any change in the model in the meantime
+     * discards the computation.
+     *
+     * Disabled by default, in which case items are laid out again on demand.
+     *
+     * \since 6.27
+     */
+    void setAsynchronousLayout(bool enable);
+
+    /*!
+     * Returns whether the view lays out its items again on worker threads when it gets resized.
+     *
+     * \since 6.27
+     */
+    bool asynchronousLayout() const;
+
+    /*!
+     * Returns the approximate memory used by the internal structures of this view.
+     *
+     * The category runs are kept by the KCategorizedSortFilterProxyModel, and shared by all the
+     * views showing it.
+     *
+     * \sa dumpMemoryUsage()
+     * \since 6.27
+     */
+    QList<KItemViewsMemoryUsage> memoryUsage() const;
+
+    /*!
+     * Writes memoryUsage() to the kf.itemviews logging category, at debug level.
+     *
+     * \since 6.27
+     */
+    void dumpMemoryUsage() const;
+
     QModelIndex indexAt(const QPoint &point) const override;
 
     void reset() override;
@@ -218,6 +434,14 @@ Q_SIGNALS:
      */
     void collapsibleBlocksChanged(bool enable);
 
+    /*!
+     * Emitted after a paint of the view that left no item drawn as a placeholder.
+     *
+     * \sa setPaintBudget()
+     * \since 6.27
+     */
+    void paintCompleted();
+
 protected:
     void paintEvent(QPaintEvent *event) override;
 
@@ -9,6 +9,10 @@
 #define KCATEGORIZEDVIEW_P_H
 
 #include "kcategorizedview.h"
+#include "kcategorizedsortfilterproxymodel_p.h"
+#include "kcategorizedviewlayout_p.h"
+
+#include <QFutureWatcher>
 
 class KCategorizedSortFilterProxyModel;
 class KCategoryDrawer;
@@ -22,7 +26,9 @@ class KCategorizedViewPrivate
 {
 public:
     struct Block;
-    struct Item;
+    struct LayoutState;
+    struct LayoutJob;
+    using Item = KCategorizedViewLayout::Item;
 
     explicit KCategorizedViewPrivate(KCategorizedView *qq);
     ~KCategorizedViewPrivate();
@@ -43,6 +49,12 @@ public:
      */
     QStyleOptionViewItem blockRect(const QModelIndex &representative);
 
+    /*!
+     * Returns the rect of the category header of the block represented by \a representative, in
+     * viewport terms. This is the only part of a block that changes when it gets hovered.
+     */
+    QRect headerRect(const QModelIndex &representative);
+
     /*!
      * Returns the first and last element that intersects with rect.
      *
@@ -85,6 +97,109 @@ public:
      */
     void rowsInserted(const QModelIndex &parent, int start, int end);
 
+    /*!
+     * Takes the rows \a start to \a end out of their blocks, before they get removed from the model.
+     *
+     * If \a category is not empty, all the rows are in that category. This is for rows the model
+     * no longer tells the category they had.
+     */
+    void rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end, const QString &category = QString());
+
+    /*!
+     * Returns whether the blocks still start at, and span, the same rows as the categories of the
+     * model.
+     *
+     * Complexity: O(n) where n is the number of categories, once the model has computed them.
+     */
+    bool blocksMatchCategoryRuns() const;
+
+    /*!
+     * Returns the category runs of the model, or nullptr if it is not categorized or the view shows
+     * the children of another index than the root.
+     */
+    const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> *categoryRuns() const;
+
+    /*!
+     * Returns the range of the category run at \a ordinal in \a runs.
+     */
+    KCategorizedView::BlockRange blockRange(const QList<KCategorizedSortFilterProxyModelPrivate::CategoryRun> &runs, int ordinal) const;
+
+    /*!
+     * Returns the memory used by the category runs of the model, as they are now.
+     */
+    KItemViewsMemoryUsage categoryRunsMemoryUsage() const;
+
+    /*!
+     * Moves a single row the model moved to follow its new sort keys from the block it was in to
+     * the block it landed in. Returns false if the blocks do not tell where the row was.
+     */
+    bool moveSortedRow(int from, int to);
+
+    /*!
+     * Keeps the blocks if the model was only sorted inside its categories, or only moved a single
+     * row, regenerating them through KCategorizedView::slotLayoutChanged() otherwise.
+     */
+    void layoutChanged(const QList<QPersistentModelIndex> &parents, QAbstractItemModel::LayoutChangeHint hint);
+
+    /*!
+     * Schedules a call to fetchMoreIfNeeded() on the next event loop iteration, unless there is
+     * one pending already.
+     */
+    void scheduleFetchMore();
+
+    /*!
+     * Asks the model for its next batch of rows if it has more, and the view is scrolled close to
+     * the end of the rows it already has.
+     */
+    void fetchMoreIfNeeded();
+
+    /*!
+     * Takes a snapshot of the sizes of all items and starts laying them out for the current
+     * viewport on worker threads. publishAsynchronousRelayout() is called once they are done.
+     *
+     * Returns false if some items were never laid out, or are in quarantine, so their sizes are
+     * not known yet.
+     */
+    bool startAsynchronousRelayout();
+
+    /*!
+     * Discards the geometry being computed on worker threads, if any.
+     */
+    void cancelAsynchronousRelayout();
+
+    /*!
+     * Replaces the geometry of all items with the one computed on worker threads, if nothing
+     * changed in the meantime.
+     */
+    void publishAsynchronousRelayout();
+
+    /*!
+     * Records that \a row was drawn as a placeholder because the paint budget was used up, and
+     * schedules paintDeferredItems() if it was not already.
+     */
+    void deferPaint(int row);
+
+    /*!
+     * Requests a paint of the items that were drawn as placeholders.
+     */
+    void paintDeferredItems();
+
+    /*!
+     * Returns the size hint of \a index, through the size hints provider if there is one.
+     */
+    QSize sizeHint(const QModelIndex &index) const;
+
+    /*!
+     * Asks the size hints provider, if any, for the size hints of rows \a start to \a end at
+     * once. sizeHint() will answer from them until clearPrefetchedSizeHints() is called.
+     */
+    void prefetchSizeHints(int start, int end);
+
+    /*!
+     * Discards the size hints stored by prefetchSizeHints().
+     */
+    void clearPrefetchedSizeHints();
+
     /*!
      * Returns \a rect in viewport terms, taking in count horizontal and vertical offsets.
      */
@@ -115,15 +230,35 @@ public:
     QString categoryForIndex(const QModelIndex &index) const;
 
     /*!
-     * Updates the visual rect for item when flow is LeftToRight.
+     * Returns the layout used for placing items, selecting it again if any of the properties it
+     * depends on changed since last time.
+     */
+    const KCategorizedViewLayout &layout();
+
+    /*!
+     * Marks the layout as outdated, so it gets selected again the next time it is needed.
+     */
+    void invalidateLayout();
+
+    /*!
+     * Reads a state written by KCategorizedView::saveLayoutState(). Returns nullptr if it is
+     * malformed or does not match \a modelFingerprint.
+     */
+    static std::unique_ptr<LayoutState> readLayoutState(const QByteArray &data, const QByteArray &modelFingerprint);
+
+    /*!
+     * Builds the blocks from the pending layout state if it matches the model. The item geometry
+     * is restored too if the view currently has the layout the state was saved with.
+     *
+     * Returns false, dropping the pending state, if it does not match the model.
      */
-    void leftToRightVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const;
+    bool applyPendingLayoutState();
 
     /*!
-     * Updates the visual rect for item when flow is TopToBottom.
-     * \note we only support viewMode == ListMode in this case.
+     * Restores the item geometry from the pending layout state, once the view has the layout it
+     * was saved with.
      */
-    void topToBottomVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const;
+    void applyPendingLayoutGeometry();
 
     /*!
      * Called when expand or collapse has been clicked on the category drawer.
@@ -132,6 +267,7 @@ public:
 
     KCategorizedView *const q;
     KCategorizedSortFilterProxyModel *proxyModel = nullptr;
+    QList<QMetaObject::Connection> proxyModelConnections;
     KCategoryDrawer *categoryDrawer = nullptr;
     int categorySpacing = 0;
     bool alternatingBlockColors = false;
@@ -145,6 +281,25 @@ public:
     QRect rubberBandRect;
 
     QHash<QString, Block> blocks;
+
+    std::unique_ptr<LayoutState> pendingLayoutState;
+
+    KCategorizedView::SizeHintsProvider sizeHintsProvider;
+    QList<QSize> prefetchedSizeHints;
+    int prefetchedSizeHintsFirstRow = 0;
+
+    KCategorizedViewLayout itemLayout;
+    bool itemLayoutDirty = true;
+
+    bool fetchMoreScheduled = false;
+
+    int paintBudget = 0;
+    int deferredPaintFirstRow = -1;
+    int deferredPaintLastRow = -1;
+
+    bool asynchronousLayout = false;
+    std::shared_ptr<LayoutJob> runningLayoutJob;
+    QFutureWatcher<void> layoutJobWatcher;
 };
 
 #endif // KCATEGORIZEDVIEW_P_H
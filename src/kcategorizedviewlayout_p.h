@@ -0,0 +1,206 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2007, 2009 Rafael Fernández López <ereslibre@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCATEGORIZEDVIEWLAYOUT_P_H
+#define KCATEGORIZEDVIEWLAYOUT_P_H
+
+#include <QListView>
+#include <QPoint>
+#include <QSize>
+
+/*!
+ * \internal
+ *
+ * Places the items of a KCategorizedView block.
+ *
+ * The layout is selected once for a set of view properties (grid, uniform or variable item
+ * sizes, layout direction and flow) and captures all the values it needs, so placing an item
+ * does not need to go through the view at all. All positions are relative to the block the
+ * item belongs to.
+ */
+class KCategorizedViewLayout
+{
+public:
+    enum ItemSizing {
+        GridSizing = 0,
+        UniformSizing,
+        VariableSizing,
+    };
+
+    struct Item {
+        QPoint topLeft;
+        QSize size;
+    };
+
+    struct Parameters {
+        ItemSizing itemSizing = VariableSizing;
+        Qt::LayoutDirection layoutDirection = Qt::LeftToRight;
+        QListView::Flow flow = QListView::LeftToRight;
+        QSize gridSize;
+        int spacing = 0;
+        int categorySpacing = 0;
+        int leftMargin = 0;
+        int viewportWidth = 0;
+
+        bool operator==(const Parameters &other) const = default;
+    };
+
+    KCategorizedViewLayout()
+        : KCategorizedViewLayout(Parameters())
+    {
+    }
+
+    explicit KCategorizedViewLayout(const Parameters &parameters)
+        : m_parameters(parameters)
+        , m_placeItem(selectPlaceItem(parameters))
+    {
+    }
+
+    const Parameters &parameters() const
+    {
+        return m_parameters;
+    }
+
+    ItemSizing itemSizing() const
+    {
+        return m_parameters.itemSizing;
+    }
+
+    /*!
+     * Updates topLeft and size of \a items[\a relativeRow], whose size hint is \a sizeHint.
+     *
+     * \note with VariableSizing the items before \a relativeRow in the same block must already
+     *       have been placed, since the item flows after them.
+     */
+    void placeItem(Item *items, int relativeRow, const QSize &sizeHint) const
+    {
+        m_placeItem(m_parameters, items, relativeRow, sizeHint);
+    }
+
+    /*!
+     * Places the \a count items of a whole block, using their current size as size hint.
+     */
+    void placeBlock(Item *items, int count) const
+    {
+        for (int i = 0; i < count; ++i) {
+            m_placeItem(m_parameters, items, i, items[i].size);
+        }
+    }
+
+private:
+    using PlaceItemFunction = void (*)(const Parameters &, Item *, int, const QSize &);
+
+    template<ItemSizing Sizing, Qt::LayoutDirection Direction, QListView::Flow Flow>
+    static void placeItemImpl(const Parameters &p, Item *items, int relativeRow, const QSize &sizeHint)
+    {
+        Item &item = items[relativeRow];
+        // the block position always starts categorySpacing pixels to the right
+        const int blockX = p.categorySpacing;
+
+        if constexpr (Flow == QListView::TopToBottom) {
+            // we only support viewMode == ListMode in this case, layout direction does not matter
+            if constexpr (Sizing == GridSizing) {
+                item.topLeft = QPoint(blockX + p.leftMargin, relativeRow * p.gridSize.height());
+            } else if constexpr (Sizing == UniformSizing) {
+                item.topLeft = QPoint(blockX + p.leftMargin, relativeRow * sizeHint.height());
+            } else {
+                item.topLeft.rx() = blockX + p.leftMargin + p.spacing;
+                if (relativeRow) {
+                    const Item &prev = items[relativeRow - 1];
+                    item.topLeft.ry() = prev.topLeft.y() + prev.size.height() + p.spacing;
+                } else {
+                    item.topLeft.ry() = p.spacing;
+                }
+            }
+            item.size = QSize(p.viewportWidth, sizeHint.height());
+        } else {
+            if constexpr (Sizing == GridSizing) {
+                const int maxItemsPerRow = qMax(p.viewportWidth / p.gridSize.width(), 1);
+                const int column = relativeRow % maxItemsPerRow;
+                if constexpr (Direction == Qt::LeftToRight) {
+                    item.topLeft.rx() = column * p.gridSize.width() + blockX + p.leftMargin;
+                } else {
+                    item.topLeft.rx() = p.viewportWidth - (column + 1) * p.gridSize.width() + p.leftMargin + p.categorySpacing;
+                }
+                item.topLeft.ry() = (relativeRow / maxItemsPerRow) * p.gridSize.height();
+            } else if constexpr (Sizing == UniformSizing) {
+                const int maxItemsPerRow = qMax((p.viewportWidth - p.spacing) / (sizeHint.width() + p.spacing), 1);
+                const int column = relativeRow % maxItemsPerRow;
+                if constexpr (Direction == Qt::LeftToRight) {
+                    item.topLeft.rx() = column * sizeHint.width() + blockX + p.leftMargin;
+                } else {
+                    item.topLeft.rx() = p.viewportWidth - column * sizeHint.width() + p.leftMargin + p.categorySpacing;
+                }
+                item.topLeft.ry() = (relativeRow / maxItemsPerRow) * sizeHint.height();
+            } else {
+                if (relativeRow) {
+                    const Item &prev = items[relativeRow - 1];
+                    const int prevRight = prev.topLeft.x() + prev.size.width();
+                    if (prevRight + sizeHint.width() - blockX + p.spacing > p.viewportWidth - p.spacing) {
+                        // we have to check the whole previous row, and see which one was the
+                        // highest.
+                        int rowBottom = prev.topLeft.y() + prev.size.height();
+                        for (int i = relativeRow - 2; i >= 0 && items[i].topLeft.y() >= prev.topLeft.y(); --i) {
+                            rowBottom = qMax(rowBottom, items[i].topLeft.y() + items[i].size.height());
+                        }
+                        if constexpr (Direction == Qt::LeftToRight) {
+                            item.topLeft.rx() = p.leftMargin + blockX + p.spacing;
+                        } else {
+                            item.topLeft.rx() = p.viewportWidth - sizeHint.width() + p.leftMargin + p.categorySpacing;
+                        }
+                        item.topLeft.ry() = rowBottom + p.spacing;
+                    } else {
+                        if constexpr (Direction == Qt::LeftToRight) {
+                            item.topLeft.rx() = prevRight + p.spacing;
+                        } else {
+                            item.topLeft.rx() = (prev.topLeft.x() - 1) - p.spacing - item.size.width() + p.leftMargin + p.categorySpacing;
+                        }
+                        item.topLeft.ry() = prev.topLeft.y();
+                    }
+                } else {
+                    if constexpr (Direction == Qt::LeftToRight) {
+                        item.topLeft.rx() = blockX + p.leftMargin + p.spacing;
+                    } else {
+                        item.topLeft.rx() = p.viewportWidth - sizeHint.width() + p.leftMargin + p.categorySpacing;
+                    }
+                    item.topLeft.ry() = p.spacing;
+                }
+            }
+            item.size = sizeHint;
+        }
+    }
+
+    template<ItemSizing Sizing>
+    static PlaceItemFunction selectPlaceItemForSizing(const Parameters &p)
+    {
+        if (p.flow == QListView::TopToBottom) {
+            return &placeItemImpl<Sizing, Qt::LeftToRight, QListView::TopToBottom>;
+        }
+        if (p.layoutDirection == Qt::RightToLeft) {
+            return &placeItemImpl<Sizing, Qt::RightToLeft, QListView::LeftToRight>;
+        }
+        return &placeItemImpl<Sizing, Qt::LeftToRight, QListView::LeftToRight>;
+    }
+
+    static PlaceItemFunction selectPlaceItem(const Parameters &p)
+    {
+        switch (p.itemSizing) {
+        case GridSizing:
+            return selectPlaceItemForSizing<GridSizing>(p);
+        case UniformSizing:
+            return selectPlaceItemForSizing<UniformSizing>(p);
+        case VariableSizing:
+            break;
+        }
+        return selectPlaceItemForSizing<VariableSizing>(p);
+    }
+
+    Parameters m_parameters;
+    PlaceItemFunction m_placeItem;
+};
+
+#endif // KCATEGORIZEDVIEWLAYOUT_P_H
@@ -132,6 +132,9 @@ protected:
      * \a blockRect The rect occupied by the block of items.
      *
      * \a event The mouse event.
+     *
+     * \note The view only repaints the category headers when the hovered block changes. If you
+     *       change the appearance of the block here, request the repaint yourself through view().
      */
     virtual void mouseMoved(const QModelIndex &index, const QRect &blockRect, QMouseEvent *event);
 
@@ -7,6 +7,7 @@
 */
 
 #include "kextendableitemdelegate.h"
+#include "kitemviewsmemoryusage_p.h"
 
 #include <QApplication>
 #include <QModelIndex>
@@ -149,6 +150,27 @@ bool KExtendableItemDelegate::isExtended(const QModelIndex &index) const
     return d->extenders.value(index);
 }
 
+QList<KItemViewsMemoryUsage> KExtendableItemDelegate::memoryUsage() const
+{
+    using namespace KItemViewsMemory;
+
+    const auto pixmapBytes = [](const QPixmap &pixmap) {
+        return qsizetype(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    };
+
+    return {
+        {QStringLiteral("extenders"), d->extenders.count(), hashBytes(d->extenders) + d->extenders.count() * persistentIndexBytes()},
+        {QStringLiteral("extender indices"), d->extenderIndices.count(), hashBytes(d->extenderIndices) + d->extenderIndices.count() * persistentIndexBytes()},
+        {QStringLiteral("deletion queue"), d->deletionQueue.count(), hashBytes(d->deletionQueue) + d->deletionQueue.count() * persistentIndexBytes()},
+        {QStringLiteral("pixmaps"), 2, pixmapBytes(d->extendPixmap) + pixmapBytes(d->contractPixmap)},
+    };
+}
+
+void KExtendableItemDelegate::dumpMemoryUsage() const
+{
+    KItemViewsMemory::dump(this, memoryUsage());
+}
+
 QSize KExtendableItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
     QSize ret;
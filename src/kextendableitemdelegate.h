@@ -13,6 +13,7 @@
 #include <memory>
 
 #include <kitemviews_export.h>
+#include <kitemviewsmemoryusage.h>
 
 class QAbstractItemView;
 
@@ -91,6 +92,21 @@ public:
      */
     virtual void updateExtenderGeometry(QWidget *extender, const QStyleOptionViewItem &option, const QModelIndex &index) const;
 
+    /*!
+     * Returns the approximate memory used by the internal structures of this delegate.
+     *
+     * \sa dumpMemoryUsage()
+     * \since 6.27
+     */
+    QList<KItemViewsMemoryUsage> memoryUsage() const;
+
+    /*!
+     * Writes memoryUsage() to the kf.itemviews logging category, at debug level.
+     *
+     * \since 6.27
+     */
+    void dumpMemoryUsage() const;
+
 Q_SIGNALS:
     /*!
      * This signal indicates that the item at \a index was extended with \a extender.
@@ -0,0 +1,167 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kitemviewsinstrumentation.h"
+#include "kitemviewsinstrumentation_p.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+#include <memory>
+
+namespace KItemViewsInstrumentationPrivate
+{
+std::atomic<bool> enabled = false;
+std::atomic<qint64> counters[counterCount] = {};
+std::atomic<bool> tracing = false;
+
+// the trace file is written from any thread the spans end in
+static QMutex s_traceMutex;
+static QFile *s_traceFile = nullptr;
+static QElapsedTimer s_traceClock;
+static bool s_firstTraceEvent = true;
+
+static const char *const s_counterNames[counterCount] = {
+    "visualRectHits",
+    "visualRectMisses",
+    "quarantineResets",
+    "layoutSweeps",
+    "blockPositionRecomputes",
+    "paints",
+    "indexAtProbes",
+    "searchLinePasses",
+    "widgetCreations",
+    "widgetReuses",
+    "widgetRecycles",
+};
+
+// must be called with s_traceMutex locked
+static void writeTraceEvent(const QByteArray &event)
+{
+    if (!s_firstTraceEvent) {
+        s_traceFile->write(",\n");
+    }
+    s_firstTraceEvent = false;
+    s_traceFile->write(event);
+}
+
+void writeSpan(const char *name, const QElapsedTimer &timer)
+{
+    const qint64 duration = timer.nsecsElapsed();
+
+    QMutexLocker locker(&s_traceMutex);
+    if (!s_traceFile) {
+        return;
+    }
+    const qint64 start = s_traceClock.nsecsElapsed() - duration;
+    writeTraceEvent(QByteArrayLiteral("{\"name\":\"") + name + QByteArrayLiteral("\",\"cat\":\"kitemviews\",\"ph\":\"X\",\"ts\":")
+                    + QByteArray::number(start / 1000) + QByteArrayLiteral(",\"dur\":") + QByteArray::number(duration / 1000)
+                    + QByteArrayLiteral(",\"pid\":") + QByteArray::number(QCoreApplication::applicationPid()) + QByteArrayLiteral(",\"tid\":")
+                    + QByteArray::number(quintptr(QThread::currentThreadId())) + '}');
+}
+}
+
+using namespace KItemViewsInstrumentationPrivate;
+
+void KItemViewsInstrumentation::setEnabled(bool enable)
+{
+    enabled = enable;
+}
+
+bool KItemViewsInstrumentation::isEnabled()
+{
+    return isActive();
+}
+
+qint64 KItemViewsInstrumentation::counter(Counter counter)
+{
+    if (counter < 0 || counter >= counterCount) {
+        return 0;
+    }
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+QString KItemViewsInstrumentation::counterName(Counter counter)
+{
+    if (counter < 0 || counter >= counterCount) {
+        return QString();
+    }
+    return QString::fromLatin1(s_counterNames[counter]);
+}
+
+void KItemViewsInstrumentation::resetCounters()
+{
+    for (std::atomic<qint64> &value : counters) {
+        value = 0;
+    }
+}
+
+void KItemViewsInstrumentation::dumpCounters()
+{
+    for (int i = 0; i < counterCount; ++i) {
+        qCDebug(KITEMVIEWS_TRACE_LOG) << s_counterNames[i] << counters[i].load(std::memory_order_relaxed);
+    }
+}
+
+bool KItemViewsInstrumentation::startTrace(const QString &fileName)
+{
+    stopTrace();
+
+    auto file = std::make_unique<QFile>(fileName);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(KITEMVIEWS_TRACE_LOG) << "Cannot write trace to" << fileName << file->errorString();
+        return false;
+    }
+    file->write("[\n");
+
+    QMutexLocker locker(&s_traceMutex);
+    s_traceFile = file.release();
+    s_traceClock.start();
+    s_firstTraceEvent = true;
+    tracing = true;
+    return true;
+}
+
+void KItemViewsInstrumentation::stopTrace()
+{
+    QMutexLocker locker(&s_traceMutex);
+    if (!s_traceFile) {
+        return;
+    }
+    tracing = false;
+
+    // the counters, as a single counter event at the end of the trace
+    QByteArray args;
+    for (int i = 0; i < counterCount; ++i) {
+        if (i) {
+            args += ',';
+        }
+        args += '"' + QByteArray(s_counterNames[i]) + QByteArrayLiteral("\":") + QByteArray::number(counters[i].load(std::memory_order_relaxed));
+    }
+    writeTraceEvent(QByteArrayLiteral("{\"name\":\"counters\",\"cat\":\"kitemviews\",\"ph\":\"C\",\"ts\":")
+                    + QByteArray::number(s_traceClock.nsecsElapsed() / 1000) + QByteArrayLiteral(",\"pid\":")
+                    + QByteArray::number(QCoreApplication::applicationPid()) + QByteArrayLiteral(",\"args\":{") + args + QByteArrayLiteral("}}"));
+    s_traceFile->write("\n]\n");
+    delete s_traceFile;
+    s_traceFile = nullptr;
+}
+
+// traces the whole run of the application when KITEMVIEWS_TRACE_FILE is set
+static void startTraceFromEnvironment()
+{
+    const QString fileName = qEnvironmentVariable("KITEMVIEWS_TRACE_FILE");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    KItemViewsInstrumentation::setEnabled(true);
+    if (KItemViewsInstrumentation::startTrace(fileName)) {
+        qAddPostRoutine(KItemViewsInstrumentation::stopTrace);
+    }
+}
+Q_COREAPP_STARTUP_FUNCTION(startTraceFromEnvironment)
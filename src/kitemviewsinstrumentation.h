@@ -0,0 +1,109 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KITEMVIEWSINSTRUMENTATION_H
+#define KITEMVIEWSINSTRUMENTATION_H
+
+#include <QString>
+
+#include <kitemviews_export.h>
+
+/*!
+ * \namespace KItemViewsInstrumentation
+ * \inmodule KItemViews
+ *
+ * \brief Counters and timed spans for the hot paths of KItemViews.
+ *
+ * Instrumentation is off by default, and costs a couple of relaxed atomic loads per hot path
+ * call while it is off. It is turned on with setEnabled(), or by enabling debug output for the
+ * kf.itemviews.trace logging category.
+ *
+ * Counters are process wide. Besides being readable with counter(), timed spans (paints, layout
+ * sweeps, search passes) can be written to a file in the Chrome trace event format with
+ * startTrace(), to be opened in chrome://tracing or Perfetto. Setting the
+ * KITEMVIEWS_TRACE_FILE environment variable to a file name traces the whole run of an
+ * application into it.
+ *
+ * \since 6.27
+ */
+namespace KItemViewsInstrumentation
+{
+/*!
+ * \value VisualRectHits KCategorizedView::visualRect() answered from the cached item geometry.
+ * \value VisualRectMisses KCategorizedView::visualRect() had to place the item.
+ * \value QuarantineResets Items of a KCategorizedView block were marked for being placed again.
+ * \value LayoutSweeps A KCategorizedView laid out all of its rows.
+ * \value BlockPositionRecomputes The position of a KCategorizedView block had to be computed.
+ * \value Paints KCategorizedView painted its viewport.
+ * \value IndexAtProbes KCategorizedView::indexAt() looked at an item.
+ * \value SearchLinePasses A search line went through the items of its view.
+ * \value WidgetCreations KWidgetItemDelegate created the widgets of an item.
+ * \value WidgetReuses KWidgetItemDelegate found the widgets of an item already created.
+ * \value WidgetRecycles KWidgetItemDelegate gave an item the widgets of an item scrolled out of view.
+ */
+enum Counter {
+    VisualRectHits = 0,
+    VisualRectMisses,
+    QuarantineResets,
+    LayoutSweeps,
+    BlockPositionRecomputes,
+    Paints,
+    IndexAtProbes,
+    SearchLinePasses,
+    WidgetCreations,
+    WidgetReuses,
+    WidgetRecycles,
+};
+
+/*!
+ * Turns the instrumentation on or off. It is also on while debug output is enabled for the
+ * kf.itemviews.trace logging category.
+ */
+KITEMVIEWS_EXPORT void setEnabled(bool enabled);
+
+/*!
+ * Returns whether counters and spans are being recorded.
+ */
+KITEMVIEWS_EXPORT bool isEnabled();
+
+/*!
+ * Returns the value of \a counter since the start of the process, or the last resetCounters().
+ */
+KITEMVIEWS_EXPORT qint64 counter(Counter counter);
+
+/*!
+ * Returns the name of \a counter, as written to the trace and the log.
+ */
+KITEMVIEWS_EXPORT QString counterName(Counter counter);
+
+/*!
+ * Sets all counters back to 0.
+ */
+KITEMVIEWS_EXPORT void resetCounters();
+
+/*!
+ * Writes the value of all counters to the kf.itemviews.trace logging category.
+ */
+KITEMVIEWS_EXPORT void dumpCounters();
+
+/*!
+ * Starts writing timed spans to \a fileName, in the Chrome trace event format. Any trace
+ * already being written is stopped first.
+ *
+ * Returns false if the file cannot be opened for writing.
+ *
+ * \sa stopTrace()
+ */
+KITEMVIEWS_EXPORT bool startTrace(const QString &fileName);
+
+/*!
+ * Writes the counters to the trace started with startTrace() and closes it.
+ */
+KITEMVIEWS_EXPORT void stopTrace();
+}
+
+#endif // KITEMVIEWSINSTRUMENTATION_H
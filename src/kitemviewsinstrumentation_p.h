@@ -0,0 +1,76 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KITEMVIEWSINSTRUMENTATION_P_H
+#define KITEMVIEWSINSTRUMENTATION_P_H
+
+#include "kitemviewsinstrumentation.h"
+
+#include <QElapsedTimer>
+
+#include <atomic>
+
+#include <kitemviews_trace_debug.h>
+
+/*
+ * What the hot paths use to record counters and spans. Everything checks isActive() first, so
+ * nothing but two relaxed loads happen while the instrumentation is off.
+ */
+namespace KItemViewsInstrumentationPrivate
+{
+constexpr int counterCount = KItemViewsInstrumentation::WidgetRecycles + 1;
+
+extern std::atomic<bool> enabled;
+extern std::atomic<qint64> counters[counterCount];
+extern std::atomic<bool> tracing;
+
+inline bool isActive()
+{
+    return enabled.load(std::memory_order_relaxed) || KITEMVIEWS_TRACE_LOG().isDebugEnabled();
+}
+
+inline void count(KItemViewsInstrumentation::Counter counter, qint64 amount = 1)
+{
+    if (isActive()) {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+void writeSpan(const char *name, const QElapsedTimer &timer);
+
+/*
+ * Measures the time until it goes out of scope, and writes it to the trace being recorded if
+ * there is one. \a name must be a string literal.
+ */
+class Span
+{
+public:
+    explicit Span(const char *name)
+        : m_name(name)
+    {
+        if (tracing.load(std::memory_order_relaxed) && isActive()) {
+            m_timer.start();
+        }
+    }
+
+    ~Span()
+    {
+        if (m_timer.isValid()) {
+            writeSpan(m_name, m_timer);
+        }
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+private:
+    const char *const m_name;
+    QElapsedTimer m_timer;
+};
+}
+
+#endif // KITEMVIEWSINSTRUMENTATION_P_H
@@ -0,0 +1,52 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KITEMVIEWSMEMORYUSAGE_H
+#define KITEMVIEWSMEMORYUSAGE_H
+
+#include <QString>
+
+/*!
+ * \class KItemViewsMemoryUsage
+ * \inmodule KItemViews
+ *
+ * \brief Approximate memory used by one internal structure of a KItemViews class.
+ *
+ * Lists of them are returned by KCategorizedView::memoryUsage(),
+ * KWidgetItemDelegate::memoryUsage() and KExtendableItemDelegate::memoryUsage(), to find out
+ * which of them grow in an application.
+ *
+ * Byte counts are estimated from the number of elements, the capacity of the containers and the
+ * size of the strings they hold. Allocator overhead and memory owned by Qt, like the widgets
+ * themselves, are not included.
+ *
+ * \since 6.27
+ */
+struct KItemViewsMemoryUsage {
+    /*!
+     * \variable KItemViewsMemoryUsage::structure
+     *
+     * A short name of the structure, stable enough to be compared between runs.
+     */
+    QString structure;
+
+    /*!
+     * \variable KItemViewsMemoryUsage::elements
+     *
+     * The number of elements in the structure.
+     */
+    qsizetype elements = 0;
+
+    /*!
+     * \variable KItemViewsMemoryUsage::bytes
+     *
+     * The approximate number of bytes used by the structure.
+     */
+    qsizetype bytes = 0;
+};
+
+#endif // KITEMVIEWSMEMORYUSAGE_H
@@ -0,0 +1,59 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KITEMVIEWSMEMORYUSAGE_P_H
+#define KITEMVIEWSMEMORYUSAGE_P_H
+
+#include "kitemviewsmemoryusage.h"
+
+#include <QHash>
+#include <QList>
+#include <QPersistentModelIndex>
+
+#include <kitemviews_debug.h>
+
+/*
+ * Helpers estimating the memory used by containers, for the memoryUsage() implementations.
+ */
+namespace KItemViewsMemory
+{
+template<typename T>
+qsizetype listBytes(const QList<T> &list)
+{
+    return list.capacity() * qsizetype(sizeof(T));
+}
+
+inline qsizetype stringBytes(const QString &string)
+{
+    return string.capacity() * qsizetype(sizeof(QChar));
+}
+
+// a byte of offset per bucket, and a node holding key and value per element
+template<typename Hash>
+qsizetype hashBytes(const Hash &hash)
+{
+    return hash.capacity() + hash.size() * qsizetype(sizeof(typename Hash::key_type) + sizeof(typename Hash::mapped_type));
+}
+
+// the shared data of the index, and its entry in the list of persistent indexes of the model
+inline qsizetype persistentIndexBytes()
+{
+    return qsizetype(sizeof(QModelIndex) + 2 * sizeof(void *) + sizeof(QPersistentModelIndex));
+}
+
+inline void dump(const QObject *owner, const QList<KItemViewsMemoryUsage> &usage)
+{
+    qsizetype total = 0;
+    for (const KItemViewsMemoryUsage &entry : usage) {
+        qCDebug(KITEMVIEWS_LOG) << owner << entry.structure << entry.elements << "elements," << entry.bytes << "bytes";
+        total += entry.bytes;
+    }
+    qCDebug(KITEMVIEWS_LOG) << owner << "total:" << total << "bytes";
+}
+}
+
+#endif // KITEMVIEWSMEMORYUSAGE_P_H
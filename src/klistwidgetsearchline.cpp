@@ -7,6 +7,7 @@
 */
 
 #include "klistwidgetsearchline.h"
+#include "kitemviewsinstrumentation_p.h"
 
 #include <QApplication>
 #include <QEvent>
@@ -72,6 +73,8 @@ void KListWidgetSearchLine::updateSearch(const QString &s)
 {
     d->search = s.isNull() ? text() : s;
     if (d->listWidget) {
+        const KItemViewsInstrumentationPrivate::Span span("KListWidgetSearchLine::updateSearch");
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::SearchLinePasses);
         d->updateHiddenState(0, d->listWidget->count() - 1);
     }
 }
@@ -8,6 +8,7 @@
 */
 
 #include "ktreewidgetsearchline.h"
+#include "kitemviewsinstrumentation_p.h"
 
 #include <QActionGroup>
 #include <QApplication>
@@ -310,6 +311,9 @@ void KTreeWidgetSearchLine::updateSearch(QTreeWidget *treeWidget)
         return;
     }
 
+    const KItemViewsInstrumentationPrivate::Span span("KTreeWidgetSearchLine::updateSearch");
+    KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::SearchLinePasses);
+
     // If there's a selected item that is visible, make sure that it's visible
     // when the search changes too (assuming that it still matches).
 
@@ -13,10 +13,12 @@
 #include <QApplication>
 #include <QCursor>
 #include <QPainter>
+#include <QScrollBar>
 #include <QStyleOption>
 #include <QTimer>
 #include <QTreeView>
 
+#include "kitemviewsmemoryusage_p.h"
 #include "kwidgetitemdelegatepool_p.h"
 
 Q_DECLARE_METATYPE(QList<QEvent::Type>)
@@ -26,6 +28,9 @@ KWidgetItemDelegatePrivate::KWidgetItemDelegatePrivate(KWidgetItemDelegate *q, Q
     , widgetPool(new KWidgetItemDelegatePool(q))
     , q(q)
 {
+    initializeTimer.setSingleShot(true);
+    initializeTimer.setInterval(0);
+    connect(&initializeTimer, SIGNAL(timeout()), this, SLOT(initializeModel()));
 }
 
 KWidgetItemDelegatePrivate::~KWidgetItemDelegatePrivate()
@@ -38,31 +43,33 @@ KWidgetItemDelegatePrivate::~KWidgetItemDelegatePrivate()
 
 void KWidgetItemDelegatePrivate::_k_slotRowsInserted(const QModelIndex &parent, int start, int end)
 {
+    Q_UNUSED(parent);
+    Q_UNUSED(start);
     Q_UNUSED(end);
-    // We need to update the rows behind the inserted row as well because the widgets need to be
-    // moved to their new position
-    updateRowRange(parent, start, model->rowCount(parent), false);
+    // The widgets of the rows behind the inserted rows need to be moved to their new position,
+    // once for all the insertions of this event loop iteration
+    scheduleInitializeModel();
 }
 
 void KWidgetItemDelegatePrivate::_k_slotRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
 {
-    updateRowRange(parent, start, end, true);
+    removeRowRange(parent, start, end);
 }
 
 void KWidgetItemDelegatePrivate::_k_slotRowsRemoved(const QModelIndex &parent, int start, int end)
 {
+    Q_UNUSED(parent);
+    Q_UNUSED(start);
     Q_UNUSED(end);
-    // We need to update the rows that come behind the deleted rows because the widgets need to be
-    // moved to the new position
-    updateRowRange(parent, start, model->rowCount(parent), false);
+    // The widgets of the rows behind the removed rows need to be moved to their new position
+    scheduleInitializeModel();
 }
 
 void KWidgetItemDelegatePrivate::_k_slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
     for (int i = topLeft.row(); i <= bottomRight.row(); ++i) {
         for (int j = topLeft.column(); j <= bottomRight.column(); ++j) {
-            const QModelIndex index = model->index(i, j, topLeft.parent());
-            widgetPool->findWidgets(index, optionView(index));
+            updateWidgets(model->index(i, j, topLeft.parent()));
         }
     }
 }
@@ -73,47 +80,34 @@ void KWidgetItemDelegatePrivate::_k_slotLayoutChanged()
     for (QWidget *widget : lst) {
         widget->setVisible(false);
     }
-    QTimer::singleShot(0, this, SLOT(initializeModel()));
+    scheduleInitializeModel();
 }
 
 void KWidgetItemDelegatePrivate::_k_slotModelReset()
 {
     widgetPool->fullClear();
-    QTimer::singleShot(0, this, SLOT(initializeModel()));
+    scheduleInitializeModel();
 }
 
 void KWidgetItemDelegatePrivate::_k_slotSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected)
 {
     const auto lstSelected = selected.indexes();
     for (const QModelIndex &index : lstSelected) {
-        widgetPool->findWidgets(index, optionView(index));
+        updateWidgets(index);
     }
     const auto lstDeselected = deselected.indexes();
     for (const QModelIndex &index : lstDeselected) {
-        widgetPool->findWidgets(index, optionView(index));
+        updateWidgets(index);
     }
 }
 
-void KWidgetItemDelegatePrivate::updateRowRange(const QModelIndex &parent, int start, int end, bool isRemoving)
+void KWidgetItemDelegatePrivate::removeRowRange(const QModelIndex &parent, int start, int end)
 {
-    int i = start;
-    while (i <= end) {
-        for (int j = 0; j < model->columnCount(parent); ++j) {
-            const QModelIndex index = model->index(i, j, parent);
-            const QList<QWidget *> widgetList =
-                widgetPool->findWidgets(index,
-                                        optionView(index),
-                                        isRemoving ? KWidgetItemDelegatePool::NotUpdateWidgets : KWidgetItemDelegatePool::UpdateWidgets);
-            if (isRemoving) {
-                for (QWidget *widget : widgetList) {
-                    const QModelIndex idx = widgetPool->d->widgetInIndex[widget];
-                    widgetPool->d->usedWidgets.remove(idx);
-                    widgetPool->d->widgetInIndex.remove(widget);
-                    delete widget;
-                }
-            }
+    const int columnCount = model->columnCount(parent);
+    for (int i = start; i <= end; ++i) {
+        for (int j = 0; j < columnCount; ++j) {
+            widgetPool->removeWidgets(model->index(i, j, parent));
         }
-        i++;
     }
 }
 
@@ -126,25 +120,156 @@ inline QStyleOptionViewItem KWidgetItemDelegatePrivate::optionView(const QModelI
     return optionView;
 }
 
-void KWidgetItemDelegatePrivate::initializeModel(const QModelIndex &parent)
+QRect KWidgetItemDelegatePrivate::visibleArea() const
 {
-    if (!model) {
+    const QRect viewportRect = itemView->viewport()->rect();
+    return viewportRect.adjusted(-viewportRect.width() / 2, -viewportRect.height() / 2, viewportRect.width() / 2, viewportRect.height() / 2);
+}
+
+void KWidgetItemDelegatePrivate::updateWidgets(const QModelIndex &index)
+{
+    if (!index.isValid()) {
         return;
     }
 
-    for (int i = 0; i < model->rowCount(parent); ++i) {
-        for (int j = 0; j < model->columnCount(parent); ++j) {
-            const QModelIndex index = model->index(i, j, parent);
-            if (index.isValid()) {
-                widgetPool->findWidgets(index, optionView(index));
+    const QStyleOptionViewItem option = optionView(index);
+    if (option.rect.intersects(visibleArea())) {
+        widgetPool->findWidgets(index, option);
+        return;
+    }
+
+    // initializeModel() releases them
+    const auto widgets = widgetPool->existingWidgets(index);
+    for (QWidget *widget : widgets) {
+        widget->setVisible(false);
+    }
+}
+
+QModelIndex KWidgetItemDelegatePrivate::adjacentRow(const QModelIndex &index, int step) const
+{
+    if (const auto *treeView = qobject_cast<const QTreeView *>(itemView)) {
+        return step > 0 ? treeView->indexBelow(index) : treeView->indexAbove(index);
+    }
+    // other views only show the children of their root index
+    return index.siblingAtRow(index.row() + step);
+}
+
+QModelIndex KWidgetItemDelegatePrivate::indexInViewport() const
+{
+    const QRect viewportRect = itemView->viewport()->rect();
+    // other views than tree views only show the children of their root index, which can change
+    const bool anchorShown = lastAnchor.isValid() && lastAnchor.model() == model
+        && (qobject_cast<const QTreeView *>(itemView) || lastAnchor.parent() == itemView->rootIndex());
+    if (anchorShown && itemView->visualRect(lastAnchor).intersects(viewportRect)) {
+        return lastAnchor;
+    }
+
+    const QPoint probes[] = {viewportRect.topLeft(), viewportRect.topRight(), viewportRect.center(), viewportRect.bottomLeft(), viewportRect.bottomRight()};
+    for (const QPoint &probe : probes) {
+        const QModelIndex index = itemView->indexAt(probe);
+        if (index.isValid()) {
+            return index;
+        }
+    }
+
+    // the probes can all fall in gaps between items, e.g. in icon mode; walking from any row
+    // still finds the ones in the area, only less quickly the further away it is
+    if (anchorShown) {
+        return lastAnchor;
+    }
+    return model->index(0, 0, itemView->rootIndex());
+}
+
+void KWidgetItemDelegatePrivate::collectVisibleIndexes(const QRect &area, QModelIndexList &indexes)
+{
+    const QModelIndex anchor = indexInViewport();
+    if (!anchor.isValid()) {
+        return;
+    }
+    lastAnchor = anchor;
+
+    // rows are laid out in order, top to bottom and in the direction of the text, so the ones
+    // in the area are found by walking from the anchor in both directions until one lies
+    // entirely before or past it
+    const bool rightToLeft = itemView->layoutDirection() == Qt::RightToLeft;
+    const auto isBeforeArea = [&area, rightToLeft](const QRect &rect) {
+        return rect.bottom() < area.top() || (rightToLeft ? rect.left() > area.right() : rect.right() < area.left());
+    };
+    const auto isPastArea = [&area, rightToLeft](const QRect &rect) {
+        return rect.top() > area.bottom() || (rightToLeft ? rect.right() < area.left() : rect.left() > area.right());
+    };
+    const auto rowRect = [this](const QModelIndex &index) {
+        QRect rect;
+        const int columnCount = model->columnCount(index.parent());
+        for (int column = 0; column < columnCount; ++column) {
+            rect |= itemView->visualRect(index.siblingAtColumn(column));
+        }
+        return rect;
+    };
+
+    QModelIndex first = anchor;
+    for (QModelIndex index = adjacentRow(anchor, -1); index.isValid(); index = adjacentRow(index, -1)) {
+        // hidden rows have no geometry and tell nothing
+        const QRect rect = rowRect(index);
+        if (!rect.isEmpty() && isBeforeArea(rect)) {
+            break;
+        }
+        first = index;
+    }
+
+    for (QModelIndex index = first; index.isValid(); index = adjacentRow(index, 1)) {
+        QRect rect;
+        QModelIndexList rowIndexes;
+        const int columnCount = model->columnCount(index.parent());
+        for (int column = 0; column < columnCount; ++column) {
+            const QModelIndex columnIndex = index.siblingAtColumn(column);
+            const QRect columnRect = itemView->visualRect(columnIndex);
+            rect |= columnRect;
+            if (columnRect.intersects(area)) {
+                rowIndexes << columnIndex;
             }
         }
-        // Check if we need to go recursively through the children of parent (if any) to initialize
-        // all possible indexes that are shown.
-        const QModelIndex index = model->index(i, 0, parent);
-        if (index.isValid() && model->hasChildren(index)) {
-            initializeModel(index);
+        if (!rect.isEmpty() && isPastArea(rect)) {
+            break;
+        }
+        indexes << rowIndexes;
+    }
+}
+
+void KWidgetItemDelegatePrivate::initializeModel(const QModelIndex &parent)
+{
+    if (!parent.isValid()) {
+        // this is the pass that was scheduled, if any
+        initializeTimer.stop();
+    }
+    if (!model) {
+        return;
+    }
+
+    QModelIndexList visibleIndexes;
+    collectVisibleIndexes(visibleArea(), visibleIndexes);
+
+    // released first, so the items scrolling in can be given the widgets of those scrolling out
+    if (!parent.isValid()) {
+        QSet<QPersistentModelIndex> keep;
+        keep.reserve(visibleIndexes.count());
+        for (const QModelIndex &index : std::as_const(visibleIndexes)) {
+            keep.insert(widgetPool->sourceIndex(index));
         }
+        widgetPool->releaseWidgetsExcept(keep);
+    }
+
+    for (const QModelIndex &index : std::as_const(visibleIndexes)) {
+        widgetPool->findWidgets(index, optionView(index));
+    }
+}
+
+void KWidgetItemDelegatePrivate::scheduleInitializeModel()
+{
+    // requests coming while a pass is scheduled, like the resize events of a resize drag, are
+    // all handled by it
+    if (!initializeTimer.isActive()) {
+        initializeTimer.start();
     }
 }
 
@@ -163,9 +288,13 @@ KWidgetItemDelegate::KWidgetItemDelegate(QAbstractItemView *itemView, QObject *p
     itemView->installEventFilter(d.get()); // keyboard events
 
     if (qobject_cast<QTreeView *>(itemView)) {
-        connect(itemView, SIGNAL(collapsed(QModelIndex)), d.get(), SLOT(initializeModel()));
-        connect(itemView, SIGNAL(expanded(QModelIndex)), d.get(), SLOT(initializeModel()));
+        connect(itemView, SIGNAL(collapsed(QModelIndex)), d.get(), SLOT(scheduleInitializeModel()));
+        connect(itemView, SIGNAL(expanded(QModelIndex)), d.get(), SLOT(scheduleInitializeModel()));
     }
+
+    // only the items around the viewport have widgets, the ones scrolling in need theirs
+    connect(itemView->verticalScrollBar(), SIGNAL(valueChanged(int)), d.get(), SLOT(scheduleInitializeModel()));
+    connect(itemView->horizontalScrollBar(), SIGNAL(valueChanged(int)), d.get(), SLOT(scheduleInitializeModel()));
 }
 
 KWidgetItemDelegate::~KWidgetItemDelegate() = default;
@@ -213,13 +342,14 @@ bool KWidgetItemDelegatePrivate::eventFilter(QObject *watched, QEvent *event)
             disconnect(model, SIGNAL(modelReset()), q, SLOT(_k_slotModelReset()));
         }
         model = itemView->model();
+        lastAnchor = QPersistentModelIndex();
         connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), q, SLOT(_k_slotRowsInserted(QModelIndex,int,int)));
         connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), q, SLOT(_k_slotRowsAboutToBeRemoved(QModelIndex,int,int)));
         connect(model, SIGNAL(rowsRemoved(QModelIndex,int,int)), q, SLOT(_k_slotRowsRemoved(QModelIndex,int,int)));
         connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), q, SLOT(_k_slotDataChanged(QModelIndex,QModelIndex)));
         connect(model, SIGNAL(layoutChanged()), q, SLOT(_k_slotLayoutChanged()));
         connect(model, SIGNAL(modelReset()), q, SLOT(_k_slotModelReset()));
-        QTimer::singleShot(0, this, SLOT(initializeModel()));
+        scheduleInitializeModel();
     }
 
     if (selectionModel != itemView->selectionModel()) {
@@ -228,7 +358,7 @@ bool KWidgetItemDelegatePrivate::eventFilter(QObject *watched, QEvent *event)
         }
         selectionModel = itemView->selectionModel();
         connect(selectionModel, SIGNAL(selectionChanged(QItemSelection,QItemSelection)), q, SLOT(_k_slotSelectionChanged(QItemSelection,QItemSelection)));
-        QTimer::singleShot(0, this, SLOT(initializeModel()));
+        scheduleInitializeModel();
     }
     // clang-format on
 
@@ -236,7 +366,7 @@ bool KWidgetItemDelegatePrivate::eventFilter(QObject *watched, QEvent *event)
     case QEvent::Polish:
     case QEvent::Resize:
         if (!qobject_cast<QAbstractItemView *>(watched)) {
-            QTimer::singleShot(0, this, SLOT(initializeModel()));
+            scheduleInitializeModel();
         }
         break;
     case QEvent::FocusIn:
@@ -244,9 +374,7 @@ bool KWidgetItemDelegatePrivate::eventFilter(QObject *watched, QEvent *event)
         if (qobject_cast<QAbstractItemView *>(watched)) {
             const auto lst = selectionModel->selectedIndexes();
             for (const QModelIndex &index : lst) {
-                if (index.isValid()) {
-                    widgetPool->findWidgets(index, optionView(index));
-                }
+                updateWidgets(index);
             }
         }
         break;
@@ -273,5 +401,55 @@ void KWidgetItemDelegate::resetModel()
     d->_k_slotModelReset();
 }
 
+void KWidgetItemDelegate::setWidgetRecyclingEnabled(bool enabled)
+{
+    KWidgetItemDelegatePoolPrivate *pool = d->widgetPool->d;
+    pool->recycling = enabled;
+    if (!enabled) {
+        for (const QList<QWidget *> &widgets : std::as_const(pool->freeWidgets)) {
+            qDeleteAll(widgets);
+        }
+        pool->freeWidgets.clear();
+    }
+}
+
+bool KWidgetItemDelegate::isWidgetRecyclingEnabled() const
+{
+    return d->widgetPool->d->recycling;
+}
+
+QList<KItemViewsMemoryUsage> KWidgetItemDelegate::memoryUsage() const
+{
+    using namespace KItemViewsMemory;
+
+    const KWidgetItemDelegatePoolPrivate *pool = d->widgetPool->d;
+
+    qsizetype widgetListBytes = 0;
+    for (const QList<QWidget *> &widgets : pool->usedWidgets) {
+        widgetListBytes += listBytes(widgets);
+    }
+    qsizetype freeWidgetListBytes = listBytes(pool->freeWidgets);
+    for (const QList<QWidget *> &widgets : pool->freeWidgets) {
+        freeWidgetListBytes += listBytes(widgets);
+    }
+
+    return {
+        {QStringLiteral("used widgets"),
+         pool->usedWidgets.count(),
+         hashBytes(pool->usedWidgets) + widgetListBytes + pool->usedWidgets.count() * persistentIndexBytes()},
+        {QStringLiteral("widget indexes"), pool->widgetInIndex.count(), hashBytes(pool->widgetInIndex) + pool->widgetInIndex.count() * persistentIndexBytes()},
+        {QStringLiteral("free widgets"), pool->freeWidgets.count(), freeWidgetListBytes},
+        // the indexes are shared with the used widgets
+        {QStringLiteral("shown indexes"),
+         pool->shownIndexes.count(),
+         pool->shownIndexes.capacity() + pool->shownIndexes.count() * qsizetype(sizeof(QPersistentModelIndex))},
+    };
+}
+
+void KWidgetItemDelegate::dumpMemoryUsage() const
+{
+    KItemViewsMemory::dump(this, memoryUsage());
+}
+
 #include "moc_kwidgetitemdelegate.cpp"
 #include "moc_kwidgetitemdelegate_p.cpp"
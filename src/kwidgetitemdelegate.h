@@ -16,6 +16,7 @@
 #include <memory>
 
 #include <kitemviews_export.h>
+#include <kitemviewsmemoryusage.h>
 
 class QObject;
 class QPainter;
@@ -77,6 +78,49 @@ public:
      */
     void resetModel();
 
+    /*!
+     * Sets whether the widgets of items scrolled out of view are handed to the items scrolling
+     * into view, rather than kept for their item.
+     *
+     * Widgets are only created for the items in or near the viewport either way. With recycling,
+     * their number stays about the number of items fitting in the viewport, however many items
+     * the view scrolls through. Without it, the widgets of an item scrolled out of view are only
+     * hidden, and deleted when the item is removed, so their number grows with the items the
+     * view has shown.
+     *
+     * Only enable this if createItemWidgets() creates the same widgets whatever the index, and
+     * its connections do not depend on it, since the widgets get another index through
+     * updateItemWidgets(), which must then set all their state. focusedIndex() follows them.
+     *
+     * Disabled by default.
+     *
+     * \since 6.27
+     */
+    void setWidgetRecyclingEnabled(bool enabled);
+
+    /*!
+     * Returns whether the widgets of items scrolled out of view are handed to other items.
+     *
+     * \sa setWidgetRecyclingEnabled()
+     * \since 6.27
+     */
+    bool isWidgetRecyclingEnabled() const;
+
+    /*!
+     * Returns the approximate memory used by the internal structures of this delegate.
+     *
+     * \sa dumpMemoryUsage()
+     * \since 6.27
+     */
+    QList<KItemViewsMemoryUsage> memoryUsage() const;
+
+    /*!
+     * Writes memoryUsage() to the kf.itemviews logging category, at debug level.
+     *
+     * \since 6.27
+     */
+    void dumpMemoryUsage() const;
+
 protected:
     /*!
      * Creates the list of widgets needed for an item.
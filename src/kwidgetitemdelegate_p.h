@@ -16,6 +16,9 @@
 #define KWIDGETITEMDELEGATE_P_H
 
 #include <QItemSelectionModel>
+#include <QPersistentModelIndex>
+#include <QRect>
+#include <QTimer>
 
 class KWidgetItemDelegate;
 
@@ -35,12 +38,53 @@ public:
     void _k_slotModelReset();
     void _k_slotSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
 
-    void updateRowRange(const QModelIndex &parent, int start, int end, bool isRemoving);
+    void removeRowRange(const QModelIndex &parent, int start, int end);
     QStyleOptionViewItem optionView(const QModelIndex &index);
 
+    /*
+     * Returns the part of the viewport items get widgets in: the viewport, with half of its size
+     * as a margin on every side, so widgets are ready before they scroll in.
+     */
+    QRect visibleArea() const;
+
+    /*
+     * Updates the widgets of index if it is in the visible area, creating them if needed, and
+     * hides them otherwise.
+     */
+    void updateWidgets(const QModelIndex &index);
+
+    /*
+     * Returns the row shown after (step > 0) or before (step < 0) the one of index, descending
+     * into the expanded items of tree views.
+     */
+    QModelIndex adjacentRow(const QModelIndex &index, int step) const;
+
+    /*
+     * Returns the index to start looking for the items of the visible area from: the anchor of
+     * the previous pass if it is still in the viewport, else an item at a corner or the center
+     * of the viewport, else any item. Returns an invalid index if the view shows none.
+     */
+    QModelIndex indexInViewport() const;
+
+    /*
+     * Appends to indexes the items which are shown in area, found from the rows around the
+     * viewport only.
+     */
+    void collectVisibleIndexes(const QRect &area, QModelIndexList &indexes);
+
 public Q_SLOTS:
+    /*
+     * Updates the widgets of the items in the visible area, and releases the others unless
+     * parent is valid.
+     */
     void initializeModel(const QModelIndex &parent = QModelIndex());
 
+    /*
+     * Makes initializeModel() run once the events being handled are, unless it is scheduled
+     * already.
+     */
+    void scheduleInitializeModel();
+
 protected:
     bool eventFilter(QObject *watched, QEvent *event) override;
 
@@ -50,6 +94,8 @@ public:
     QAbstractItemModel *model = nullptr;
     QItemSelectionModel *selectionModel = nullptr;
     bool viewDestroyed = false;
+    QTimer initializeTimer;
+    QPersistentModelIndex lastAnchor;
 
     KWidgetItemDelegate *const q;
 };
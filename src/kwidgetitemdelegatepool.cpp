@@ -18,8 +18,11 @@
 #include <QWidget>
 #include <qobjectdefs.h>
 
+#include <utility>
+
 #include "kwidgetitemdelegate.h"
 #include "kwidgetitemdelegate_p.h"
+#include "kitemviewsinstrumentation_p.h"
 #include <kitemviews_debug.h>
 
 class KWidgetItemDelegateEventListener : public QObject
@@ -63,20 +66,24 @@ KWidgetItemDelegatePool::findWidgets(const QPersistentModelIndex &idx, const QSt
         return result;
     }
 
-    QModelIndex index;
-    if (const QAbstractProxyModel *proxyModel = qobject_cast<const QAbstractProxyModel *>(idx.model())) {
-        index = proxyModel->mapToSource(idx);
-    } else {
-        index = idx;
-    }
-
+    const QPersistentModelIndex index = sourceIndex(idx);
     if (!index.isValid()) {
         return result;
     }
 
     if (d->usedWidgets.contains(index)) {
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::WidgetReuses);
         result = d->usedWidgets[index];
+    } else if (d->recycling && !d->freeWidgets.isEmpty()) {
+        // updateItemWidgets() below sets them up for their new index
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::WidgetRecycles);
+        result = d->freeWidgets.takeLast();
+        d->usedWidgets[index] = result;
+        for (QWidget *widget : std::as_const(result)) {
+            d->widgetInIndex[widget] = index;
+        }
     } else {
+        KItemViewsInstrumentationPrivate::count(KItemViewsInstrumentation::WidgetCreations);
         result = d->delegate->createItemWidgets(index);
         d->usedWidgets[index] = result;
         for (QWidget *widget : std::as_const(result)) {
@@ -87,6 +94,8 @@ KWidgetItemDelegatePool::findWidgets(const QPersistentModelIndex &idx, const QSt
         }
     }
 
+    d->shownIndexes.insert(index);
+
     if (updateWidgets == UpdateWidgets) {
         for (QWidget *widget : std::as_const(result)) {
             widget->setVisible(true);
@@ -102,6 +111,67 @@ KWidgetItemDelegatePool::findWidgets(const QPersistentModelIndex &idx, const QSt
     return result;
 }
 
+QList<QWidget *> KWidgetItemDelegatePool::existingWidgets(const QModelIndex &index) const
+{
+    return d->usedWidgets.value(sourceIndex(index));
+}
+
+QPersistentModelIndex KWidgetItemDelegatePool::sourceIndex(const QModelIndex &index) const
+{
+    if (const QAbstractProxyModel *proxyModel = qobject_cast<const QAbstractProxyModel *>(index.model())) {
+        return proxyModel->mapToSource(index);
+    }
+    return index;
+}
+
+void KWidgetItemDelegatePool::releaseWidgetsExcept(const QSet<QPersistentModelIndex> &keep)
+{
+    // only the indexes shown since the previous pass can have visible widgets
+    const QSet<QPersistentModelIndex> shownIndexes = std::exchange(d->shownIndexes, keep);
+    for (const QPersistentModelIndex &index : shownIndexes) {
+        // the widgets of removed indexes are handled by removeWidgets() and
+        // invalidIndexesWidgets()
+        if (!index.isValid() || keep.contains(index)) {
+            continue;
+        }
+        if (d->recycling) {
+            const QList<QWidget *> widgets = d->usedWidgets.take(index);
+            for (QWidget *widget : widgets) {
+                widget->setVisible(false);
+                d->widgetInIndex.remove(widget);
+            }
+            d->freeWidgets << widgets;
+        } else {
+            const QList<QWidget *> widgets = d->usedWidgets.value(index);
+            for (QWidget *widget : widgets) {
+                widget->setVisible(false);
+            }
+        }
+    }
+}
+
+void KWidgetItemDelegatePool::removeWidgets(const QModelIndex &index)
+{
+    const QPersistentModelIndex persistentIndex = sourceIndex(index);
+    d->shownIndexes.remove(persistentIndex);
+    const QList<QWidget *> widgets = d->usedWidgets.take(persistentIndex);
+    if (widgets.isEmpty()) {
+        return;
+    }
+
+    for (QWidget *widget : widgets) {
+        d->widgetInIndex.remove(widget);
+    }
+    if (d->recycling) {
+        for (QWidget *widget : widgets) {
+            widget->setVisible(false);
+        }
+        d->freeWidgets << widgets;
+    } else {
+        qDeleteAll(widgets);
+    }
+}
+
 QList<QWidget *> KWidgetItemDelegatePool::invalidIndexesWidgets() const
 {
     QList<QWidget *> result;
@@ -126,9 +196,14 @@ void KWidgetItemDelegatePool::fullClear()
 {
     d->clearing = true;
     qDeleteAll(d->widgetInIndex.keys());
+    for (const QList<QWidget *> &widgets : std::as_const(d->freeWidgets)) {
+        qDeleteAll(widgets);
+    }
     d->clearing = false;
     d->usedWidgets.clear();
     d->widgetInIndex.clear();
+    d->shownIndexes.clear();
+    d->freeWidgets.clear();
 }
 
 bool KWidgetItemDelegateEventListener::eventFilter(QObject *watched, QEvent *event)
@@ -12,6 +12,7 @@
 #include <QHash>
 #include <QList>
 #include <QPersistentModelIndex>
+#include <QSet>
 
 class QWidget;
 class QStyleOptionViewItem;
@@ -41,6 +42,28 @@ public:
      */
     QList<QWidget *> findWidgets(const QPersistentModelIndex &index, const QStyleOptionViewItem &option, UpdateWidgetsEnum updateWidgets = UpdateWidgets) const;
 
+    /*
+     * Returns the widgets of index if they were created already, without creating them.
+     */
+    QList<QWidget *> existingWidgets(const QModelIndex &index) const;
+
+    /*
+     * Returns the index of the source model the widgets of index are stored for.
+     */
+    QPersistentModelIndex sourceIndex(const QModelIndex &index) const;
+
+    /*
+     * Hides the widgets of the indexes shown since the previous call but not in keep, and gives
+     * them back to the free widgets when recycling. Without recycling, they are kept for their
+     * index until it is removed.
+     */
+    void releaseWidgetsExcept(const QSet<QPersistentModelIndex> &keep);
+
+    /*
+     * Deletes the widgets of index, or gives them back to the free widgets when recycling.
+     */
+    void removeWidgets(const QModelIndex &index);
+
     QList<QWidget *> invalidIndexesWidgets() const;
 
     void fullClear();
@@ -64,6 +87,13 @@ public:
     QHash<QPersistentModelIndex, QList<QWidget *>> usedWidgets;
     QHash<QWidget *, QPersistentModelIndex> widgetInIndex;
 
+    // hidden widget lists of items scrolled out of view, given to the next items needing some
+    QList<QList<QWidget *>> freeWidgets;
+    bool recycling = false;
+
+    // indexes whose widgets were shown since the last releaseWidgetsExcept()
+    QSet<QPersistentModelIndex> shownIndexes;
+
     bool clearing = false;
 };
 